@@ -39,3 +39,42 @@ params+="-o $outDir/$appName "
 
 echo "building $appName..."
 clang++ $params
+
+###### compile Compile.o
+appName="Compile.o"
+cFile="../src/ViolaJones/Compile/Compile.cpp"
+params=" -O3 -std=c++20 "
+params+="$noWarnings "
+params+="$includeDirs "
+params+="$cFile "
+params+="$libs "
+params+="-o $outDir/$appName "
+
+echo "building $appName..."
+clang++ $params
+
+###### compile Calibrate.o
+appName="Calibrate.o"
+cFile="../src/ViolaJones/Calibrate/Calibrate.cpp"
+params=" -O3 -std=c++20 "
+params+="$noWarnings "
+params+="$includeDirs "
+params+="$cFile "
+params+="$libs "
+params+="-o $outDir/$appName "
+
+echo "building $appName..."
+clang++ $params
+
+###### compile Pack.o
+appName="Pack.o"
+cFile="../src/ViolaJones/Pack/Pack.cpp"
+params=" -O3 -std=c++20 "
+params+="$noWarnings "
+params+="$includeDirs "
+params+="$cFile "
+params+="$libs "
+params+="-o $outDir/$appName "
+
+echo "building $appName..."
+clang++ $params
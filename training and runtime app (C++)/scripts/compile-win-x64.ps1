@@ -50,3 +50,51 @@ $params = @($params) -join " "
 Write-Output "building $appName..." 
 Invoke-Expression ("cl " + $params)
 Remove-Item -Path "Train.obj" -Force
+
+###### compile Compile.exe
+$appName = "Compile.exe"
+$cFile = "../src/ViolaJones/Compile/Compile.cpp"
+$params = 
+   "/Ox /std:c++20 /EHsc /MT",
+   $includeDirs, 
+   $cFile,
+   "/link",
+   $libs,
+   "/out:$outDir/$appName"
+
+$params = @($params) -join " "
+Write-Output "building $appName..." 
+Invoke-Expression ("cl " + $params)
+Remove-Item -Path "Compile.obj" -Force
+
+###### compile Calibrate.exe
+$appName = "Calibrate.exe"
+$cFile = "../src/ViolaJones/Calibrate/Calibrate.cpp"
+$params = 
+   "/Ox /std:c++20 /EHsc /MT",
+   $includeDirs, 
+   $cFile,
+   "/link",
+   $libs,
+   "/out:$outDir/$appName"
+
+$params = @($params) -join " "
+Write-Output "building $appName..." 
+Invoke-Expression ("cl " + $params)
+Remove-Item -Path "Calibrate.obj" -Force
+
+###### compile Pack.exe
+$appName = "Pack.exe"
+$cFile = "../src/ViolaJones/Pack/Pack.cpp"
+$params = 
+   "/Ox /std:c++20 /EHsc /MT",
+   $includeDirs, 
+   $cFile,
+   "/link",
+   $libs,
+   "/out:$outDir/$appName"
+
+$params = @($params) -join " "
+Write-Output "building $appName..." 
+Invoke-Expression ("cl " + $params)
+Remove-Item -Path "Pack.obj" -Force
@@ -68,12 +68,26 @@ namespace System::Collections::Generic
             return this->data + this->length;
         }
 
+        const T* begin() const
+        {
+            return this->data;
+        }
+
+        const T* end() const
+        {
+            return this->data + this->length;
+        }
 
         long Count()
         {
             return this->length;
         }
 
+        long Count() const
+        {
+            return this->length;
+        }
+
         long Capacity()
         {
             return this->capacity;
@@ -6,6 +6,7 @@ namespace System::Diagnostics
 {
 #define SEC_TO_MS(sec) ((sec)*1000)
 #define NS_TO_MS(ns)    ((ns)/1000000)
+#define SEC_TO_NS(sec) ((sec)*1000000000)
 
 	class Stopwatch
 	{
@@ -22,6 +23,18 @@ namespace System::Diagnostics
 			return ms;
 		}
 
+		static UInt64 TotalNanoseconds()
+		{
+			struct timespec ts;
+			bool ok = timespec_get(&ts, TIME_UTC) == TIME_UTC;
+			
+			if (!ok)
+				throw Exception("Error getting elapsed time.");
+
+			UInt64 ns = SEC_TO_NS((UInt64)ts.tv_sec) + (UInt64)ts.tv_nsec;
+			return ns;
+		}
+
 		static double TotalSeconds()
 		{
 			return (double)TotalMilliseconds() / 1000;
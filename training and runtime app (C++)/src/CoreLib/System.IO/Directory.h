@@ -38,6 +38,18 @@ namespace System::IO
 			return files;
 		}
 
+		static List<string> GetDirectories(const string& dirPath)
+		{
+			if (Exists(dirPath) == false)
+				throw IOException("The specified directory: '" + dirPath + "' does not exist.");
+
+			List<string> files;
+			List<string> folders;
+			GetSystemItems(dirPath, "", files, folders);
+
+			return folders;
+		}
+
 		static bool Exists(const string& dirPath)
 		{
 			struct stat sb;
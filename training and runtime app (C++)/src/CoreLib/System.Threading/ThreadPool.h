@@ -23,6 +23,8 @@ namespace System::Threading
     public:
         void Start() 
         {
+            shouldTerminate = false; //the pool may be restarted after Stop
+
             for (var i = 0; i < threadCount; i++)
             {
                 var thread = Thread<ThreadPoolBase<T>*>::Run(ThreadLoop, this);
@@ -53,10 +55,13 @@ namespace System::Threading
             runningCount++;
             queueMutex.Unlock();
 
-            while (waitIfAllThreadsBusy && AreAllThreadsBusy())
-                waitOneCond.Wait(waitOneMutex);
-
             queueCond.Wake();
+
+            //the condition is checked under the same mutex the workers use to update it, so no wake-up is lost
+            queueMutex.Lock();
+            while (waitIfAllThreadsBusy && runningCount >= threads.Count())
+                waitOneCond.Wait(queueMutex);
+            queueMutex.Unlock();
         }
 
         bool IsBusy()
@@ -70,8 +75,10 @@ namespace System::Threading
 
         void WaitAll()
         {
-            while (IsBusy())
-                waitOneCond.Wait(waitOneMutex);
+            queueMutex.Lock();
+            while (runningCount != 0)
+                waitOneCond.Wait(queueMutex);
+            queueMutex.Unlock();
         }
 
         int ThreadCount()
@@ -102,18 +109,8 @@ namespace System::Threading
         Queue<T> jobs;
 
         int runningCount = 0;
-        Mutex waitOneMutex;
         CondVar waitOneCond;
 
-        bool AreAllThreadsBusy()
-        {
-            queueMutex.Lock();
-            var isBusy = runningCount >= threads.Count();
-            queueMutex.Unlock();
-
-            return isBusy;
-        }
-
         static void ThreadLoop(ThreadPoolBase<T>* pool)
         {
             while (true)
@@ -139,9 +136,8 @@ namespace System::Threading
                 //notify that we are finished with one thread
                 pool->queueMutex.Lock();      
                 pool->runningCount--;
-                pool->queueMutex.Unlock();
-
                 pool->waitOneCond.WakeAll();
+                pool->queueMutex.Unlock();
             }
 
             //notify that we are finished if the pool is stopped
@@ -0,0 +1,95 @@
+#include "Calibrate.hpp"
+#include <Extensions/ConsoleExtensions.h>
+
+using namespace System;
+using namespace ViolaJones;
+
+/// @brief Runs the app - parses the arguments, re-tunes stage thresholds and writes the calibrated cascade.
+/// @param args Console args.
+static void RunApp(List<string>& args)
+{
+    if (args.Count() < 2 || args.Count() > 4)
+        throw Exception((string)"Invalid number of arguments.");
+
+    var cascadeFile  = args[0];
+    var dbPath       = args[1];
+    var targetRecall = (args.Count() >= 3) ? (float)String::ParseDouble(args[2]) : 0.95f;
+    var outFile      = (args.Count() == 4) ? args[3] : CALIBRATED_CASCADE_FILE_NAME;
+
+    if (File::Exists(cascadeFile) == false)
+        throw ArgumentException("The specified cascade does not exist: " + cascadeFile);
+
+    if (targetRecall <= 0 || targetRecall > 1)
+        throw ArgumentException((string)"The target recall must be in range (0..1].");
+
+    var cascade = Cascade::FromFile(cascadeFile);
+    if (cascade.StageCount() == 0)
+        throw ArgumentException("The specified cascade does not contain any stage: " + cascadeFile);
+
+    Console::WriteLine((string)"Cascade: " + cascadeFile + " (trees: " + (int)cascade.Trees.Count() + ", stages: " + cascade.StageCount() + ")");
+
+    //validation data
+    Console::WriteLine((string)"Validation set:");
+    var clipTransform = RoiRandomJitterTransform(0, 0, 0); //no jitter - only clips object ROIs to the image
+    var baseSet = LabeledDataset(dbPath, cascade.WidthHeightRatio);
+    var posSet = PositiveDataset(baseSet, &clipTransform);
+    var negSet = NegativeDataset(baseSet);
+
+    if (posSet.Count() == 0)
+        throw ArgumentException("The validation set does not contain any object: " + dbPath);
+
+    var set = CreateCalibrationSet(cascade, posSet, negSet, CALIBRATION_NEGATIVE_COUNT);
+
+    //original operating point
+    var thresholds = List<float>();
+    for (var stageEnd: cascade.StageEnds)
+        thresholds.Add(cascade.Trees[stageEnd].Threshold);
+
+    var original = EvaluateThresholds(cascade, set, thresholds);
+    Console::WriteLine((string)"Original   - recall: " + String(original.Recall, 4) + ", FPR: " + String(original.FPR, 6) + ", trees/window: " + String(original.TreesPerWindow, 2));
+
+    //calibration
+    var curve = List<CalibrationPoint>();
+    thresholds = CalibrateThresholds(cascade, set, targetRecall, curve);
+
+    Console::WriteLine((string)"Speed / recall curve:");
+    Console::Write(CalibrationCurveReport(curve));
+
+    var calibrated = curve[curve.Count() - 1];
+    Console::WriteLine((string)"Calibrated - recall: " + String(calibrated.Recall, 4) + ", FPR: " + String(calibrated.FPR, 6) + ", trees/window: " + String(calibrated.TreesPerWindow, 2));
+
+    //only stage thresholds are modified
+    for (var stageIdx = 0; stageIdx < cascade.StageCount(); stageIdx++)
+        cascade.Trees[cascade.StageEnds[stageIdx]].Threshold = thresholds[stageIdx];
+
+    cascade.UpdateRejectBounds();
+    cascade.ToFile(outFile);
+    Console::WriteLine((string)"Calibrated cascade written to: " + outFile);
+}
+
+int main(int argCount, char* argValues[])
+{
+    Console::ForegroundColor = ConsoleColor::Green;
+    Console::WriteLine((string)"Cascade calibration (Viola Jones) - re-tunes stage thresholds for a target recall at the lowest cost.");
+
+    Console::ForegroundColor = ConsoleColor::Yellow;
+    Console::WriteLine((string)"Arguments: <cascade path> <validation database path> [target recall] = 0.95 [output path] = 'cascade-calibrated.bin'");
+    Console::WriteLine((string)"\tExample: 'Calibrate cascade.bin validation/ 0.97 cascade-calibrated.bin'");
+    Console::WriteLine((string)"Validation database has the same format as the training one (images + YOLOv3 label files).");
+    Console::WriteLine();
+
+    Console::ForegroundColor = ConsoleColor::Default;
+
+    try
+    {
+        var arguments = GetArguments(argCount, argValues);
+        RunApp(arguments);
+    }
+    catch (Exception& ex)
+    {
+        Console::Error(ex);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "../Shared/Cascade.hpp"
+#include "../Shared/Config.hpp"
+#include "../Test/Test.hpp"
+#include "../Train/Dataset/Dataset.hpp"
+#include <cmath>
+
+namespace ViolaJones
+{
+    /// @brief Validation windows evaluated by all cascade trees. Stage thresholds are re-tuned on it without evaluating the trees again.
+    struct CalibrationSet
+    {
+        int StageCount = 0;
+        /// @brief True for positive (object) windows, false for negative ones.
+        List<bool> Labels;
+        /// @brief Window confidence at the end of each stage [sampleIdx * StageCount + stageIdx].
+        List<float> StageConfs;
+        /// @brief Index of a tree whose intermediate (soft cascade) threshold rejects a window within each stage, -1 if none [sampleIdx * StageCount + stageIdx].
+        List<int> SoftExits;
+
+        long Count()
+        {
+            return Labels.Count();
+        }
+    };
+
+    /// @brief A point on a speed / recall curve.
+    struct CalibrationPoint
+    {
+        /// @brief Ratio of accepted positive windows.
+        float Recall;
+        /// @brief Ratio of accepted negative windows.
+        float FPR;
+        /// @brief Average number of evaluated trees per negative window.
+        float TreesPerWindow;
+    };
+
+    /// @brief Evaluates all trees of a cascade on a window and adds its stage confidences to the set.
+    /// @param cascade Cascade to evaluate.
+    /// @param set Calibration set.
+    /// @param patch Window (grayscale patch).
+    /// @param label True for a positive window, false otherwise.
+    static void AddCalibrationSample(Cascade& cascade, CalibrationSet& set, cv::Mat& patch, bool label)
+    {
+        var confidence = 0.0f;
+        var stageIdx = 0, softExit = -1;
+
+        for (var treeIdx = 0; treeIdx < cascade.Trees.Count() && stageIdx < set.StageCount; treeIdx++)
+        {
+            confidence += EvalTree(cascade.Trees[treeIdx], patch);
+
+            if (treeIdx == cascade.StageEnds[stageIdx])
+            {
+                set.StageConfs.Add(confidence);
+                set.SoftExits.Add(softExit);
+
+                stageIdx++;
+                softExit = -1;
+                continue;
+            }
+
+            if (softExit == -1 && confidence < cascade.Trees[treeIdx].Threshold)
+                softExit = treeIdx;
+        }
+
+        set.Labels.Add(label);
+    }
+
+    /// @brief Creates a calibration set from validation positives (all objects) and random negative windows.
+    /// @param cascade Cascade to calibrate.
+    /// @param positives Positive dataset.
+    /// @param negatives Negative dataset.
+    /// @param negativeCount Number of negative windows to sample.
+    /// @return Calibration set.
+    CalibrationSet CreateCalibrationSet(Cascade& cascade, LabeledDataset& positives, LabeledDataset& negatives, int negativeCount)
+    {
+        var set = CalibrationSet();
+        set.StageCount = cascade.StageCount();
+
+        for (var i = 0; i < positives.Count(); i++)
+        {
+            var patch = positives[i];
+            AddCalibrationSample(cascade, set, patch, true);
+            Console::Progress((float)(i + 1) / positives.Count(), (string)"\tPositives...");
+        }
+
+        for (var i = 0; i < negativeCount; i++)
+        {
+            var patch = negatives[i];
+            AddCalibrationSample(cascade, set, patch, false);
+            Console::Progress((float)(i + 1) / negativeCount, (string)"\tNegatives...");
+        }
+
+        return set;
+    }
+
+    /// @brief Gets the stage where a window leaves the cascade.
+    /// @param set Calibration set.
+    /// @param sampleIdx Window index.
+    /// @param thresholds Stage thresholds.
+    /// @return Exit stage; StageCount if the window is accepted.
+    static int GetExitStage(CalibrationSet& set, long sampleIdx, List<float>& thresholds)
+    {
+        for (var stageIdx = 0; stageIdx < set.StageCount; stageIdx++)
+        {
+            var i = sampleIdx * set.StageCount + stageIdx;
+            if (set.SoftExits[i] != -1 || set.StageConfs[i] < thresholds[stageIdx])
+                return stageIdx;
+        }
+
+        return set.StageCount;
+    }
+
+    /// @brief Gets the number of trees evaluated for a window leaving the cascade at the specified stage.
+    /// @param cascade Calibrated cascade.
+    /// @param set Calibration set.
+    /// @param sampleIdx Window index.
+    /// @param exitStage Exit stage (StageCount if accepted).
+    /// @return Number of evaluated trees.
+    static int GetExitCost(Cascade& cascade, CalibrationSet& set, long sampleIdx, int exitStage)
+    {
+        if (exitStage == set.StageCount)
+            return cascade.Trees.Count();
+
+        var softExit = set.SoftExits[sampleIdx * set.StageCount + exitStage];
+        return (softExit != -1) ? softExit + 1 : cascade.StageEnds[exitStage] + 1;
+    }
+
+    /// @brief Measures recall, FPR and cost for the current exit stages.
+    /// @param cascade Calibrated cascade.
+    /// @param set Calibration set.
+    /// @param exitStages Exit stage of each window.
+    /// @return Curve point.
+    static CalibrationPoint MeasureCalibrationPoint(Cascade& cascade, CalibrationSet& set, List<int>& exitStages)
+    {
+        var nPos = 0l, nNeg = 0l, nAcceptedPos = 0l, nAcceptedNeg = 0l, negTreeCount = 0l;
+
+        for (var i = 0; i < set.Count(); i++)
+        {
+            var isAccepted = exitStages[i] == set.StageCount;
+
+            if (set.Labels[i])
+            {
+                nPos++;
+                nAcceptedPos += isAccepted;
+            }
+            else
+            {
+                nNeg++;
+                nAcceptedNeg += isAccepted;
+                negTreeCount += GetExitCost(cascade, set, i, exitStages[i]);
+            }
+        }
+
+        var point = CalibrationPoint();
+        point.Recall         = (float)nAcceptedPos / Math::Max(1l, nPos);
+        point.FPR            = (float)nAcceptedNeg / Math::Max(1l, nNeg);
+        point.TreesPerWindow = (float)negTreeCount / Math::Max(1l, nNeg);
+        return point;
+    }
+
+    /// @brief Evaluates the provided stage thresholds on the calibration set.
+    /// @param cascade Calibrated cascade.
+    /// @param set Calibration set.
+    /// @param thresholds Stage thresholds.
+    /// @return Curve point.
+    CalibrationPoint EvaluateThresholds(Cascade& cascade, CalibrationSet& set, List<float>& thresholds)
+    {
+        var exitStages = List<int>();
+        for (var i = 0; i < set.Count(); i++)
+            exitStages.Add(GetExitStage(set, i, thresholds));
+
+        return MeasureCalibrationPoint(cascade, set, exitStages);
+    }
+
+    /// @brief Gets the lowest and the second lowest (distinct) confidence of accepted positives at the end of a stage.
+    /// @param set Calibration set.
+    /// @param exitStages Exit stage of each window.
+    /// @param stageIdx Stage index.
+    /// @return Lowest and second lowest confidence (infinity if not found).
+    static Tuple<float, float> GetLowestPositiveConfs(CalibrationSet& set, List<int>& exitStages, int stageIdx)
+    {
+        var lowest = INFINITY, secondLowest = INFINITY;
+
+        for (var i = 0; i < set.Count(); i++)
+        {
+            if (!set.Labels[i] || exitStages[i] != set.StageCount)
+                continue;
+
+            var conf = set.StageConfs[i * set.StageCount + stageIdx];
+            if (conf < lowest)
+            {
+                secondLowest = lowest;
+                lowest = conf;
+            }
+            else if (conf > lowest && conf < secondLowest)
+                secondLowest = conf;
+        }
+
+        return Tuple<float, float>(lowest, secondLowest);
+    }
+
+    /// @brief Raises a stage threshold and updates exit stages of windows which are rejected by it.
+    /// @param set Calibration set.
+    /// @param exitStages Exit stage of each window.
+    /// @param thresholds Stage thresholds.
+    /// @param stageIdx Stage index.
+    /// @param threshold New (higher) threshold.
+    static void RaiseStageThreshold(CalibrationSet& set, List<int>& exitStages, List<float>& thresholds, int stageIdx, float threshold)
+    {
+        for (var i = 0; i < set.Count(); i++)
+        {
+            if (exitStages[i] > stageIdx && set.StageConfs[i * set.StageCount + stageIdx] < threshold)
+                exitStages[i] = stageIdx;
+        }
+
+        thresholds[stageIdx] = threshold;
+    }
+
+    /// @brief Re-tunes stage thresholds (trees are not modified) to reach the target recall at the lowest average number of trees per negative window.
+    ///        Starting from the max recall (no stage rejects an accepted positive), each step raises the threshold of a stage which rejects the lowest accepted positive(s)
+    ///        and saves the most tree evaluations of negatives per rejected positive. Steps are repeated while the target recall is retained.
+    /// @param cascade Cascade to calibrate.
+    /// @param set Calibration set.
+    /// @param targetRecall Min recall (ratio of accepted positive windows) to retain.
+    /// @param curve Is filled with the speed / recall curve (one point per step).
+    /// @return Stage thresholds.
+    List<float> CalibrateThresholds(Cascade& cascade, CalibrationSet& set, float targetRecall, List<CalibrationPoint>& curve)
+    {
+        var thresholds = List<float>();
+        thresholds.Add(-1000.0f, set.StageCount); //no stage rejects a window (soft exits only)
+
+        var exitStages = List<int>();
+        var nPos = 0l, nAcceptedPos = 0l;
+        for (var i = 0; i < set.Count(); i++)
+        {
+            exitStages.Add(GetExitStage(set, i, thresholds));
+
+            nPos += set.Labels[i];
+            nAcceptedPos += set.Labels[i] && exitStages[i] == set.StageCount;
+        }
+
+        var minAcceptedPos = (long)Math::Ceil(targetRecall * nPos);
+        if (nAcceptedPos < minAcceptedPos)
+            Console::Warning((string)"The target recall can not be reached (soft thresholds). Max recall: " + String((float)nAcceptedPos / Math::Max(1l, nPos), 4));
+
+        while (true)
+        {
+            //raise each stage threshold up to the lowest accepted positive (no positive is lost)
+            for (var stageIdx = 0; stageIdx < set.StageCount; stageIdx++)
+            {
+                var [lowest, _] = GetLowestPositiveConfs(set, exitStages, stageIdx);
+                if (lowest != INFINITY && lowest > thresholds[stageIdx])
+                    RaiseStageThreshold(set, exitStages, thresholds, stageIdx, lowest);
+            }
+
+            curve.Add(MeasureCalibrationPoint(cascade, set, exitStages));
+
+            //find the stage which saves the most trees per lost positive
+            var bestStage = -1; var bestThreshold = 0.0f; var bestLost = 0l; var bestScore = -1.0;
+
+            for (var stageIdx = 0; stageIdx < set.StageCount; stageIdx++)
+            {
+                var [lowest, secondLowest] = GetLowestPositiveConfs(set, exitStages, stageIdx);
+                if (lowest == INFINITY)
+                    continue;
+
+                var threshold = (secondLowest != INFINITY) ? secondLowest : std::nextafter(lowest, INFINITY);
+                var lostPos = 0l, savedTrees = 0l;
+
+                for (var i = 0; i < set.Count(); i++)
+                {
+                    if (exitStages[i] <= stageIdx || set.StageConfs[i * set.StageCount + stageIdx] >= threshold)
+                        continue;
+
+                    if (set.Labels[i])
+                        lostPos += exitStages[i] == set.StageCount;
+                    else
+                        savedTrees += GetExitCost(cascade, set, i, exitStages[i]) - (cascade.StageEnds[stageIdx] + 1);
+                }
+
+                if (lostPos == 0 || savedTrees == 0 || nAcceptedPos - lostPos < minAcceptedPos) //recall is traded for speed only
+                    continue;
+
+                var score = (double)savedTrees / lostPos;
+                if (score > bestScore)
+                {
+                    bestStage = stageIdx; bestThreshold = threshold;
+                    bestLost = lostPos; bestScore = score;
+                }
+            }
+
+            if (bestStage == -1)
+                break;
+
+            RaiseStageThreshold(set, exitStages, thresholds, bestStage, bestThreshold);
+            nAcceptedPos -= bestLost;
+        }
+
+        return thresholds;
+    }
+
+    /// @brief Creates a speed / recall curve report.
+    /// @param curve Curve points (ordered by decreasing recall).
+    /// @param maxRows Max number of printed points (the first and the last point are always printed).
+    /// @return Report.
+    string CalibrationCurveReport(List<CalibrationPoint>& curve, int maxRows = 25)
+    {
+        var str = (string)"\tRecall | FPR      | trees/window\n";
+        var step = Math::Max(1, (int)Math::Ceil((float)curve.Count() / maxRows));
+
+        for (var i = 0; i < curve.Count(); i++)
+        {
+            if (i % step != 0 && i != curve.Count() - 1)
+                continue;
+
+            var& p = curve[i];
+            str = str + "\t" + String(p.Recall, 4).PadLeft(6) + " | " + String(p.FPR, 6).PadLeft(8) + " | " + String(p.TreesPerWindow, 2).PadLeft(12) + "\n";
+        }
+
+        return str;
+    }
+}
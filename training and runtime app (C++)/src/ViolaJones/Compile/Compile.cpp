@@ -0,0 +1,52 @@
+#include "Compile.hpp"
+#include <Extensions/ConsoleExtensions.h>
+
+using namespace System;
+using namespace ViolaJones;
+
+/// @brief Runs the app - parses the arguments and generates a C++ source of a cascade.
+/// @param args Console args.
+static void RunApp(List<string>& args)
+{
+    if (args.Count() > 2)
+        throw Exception((string)"Invalid number of arguments.");
+
+    var cascadeFile = (args.Count() >= 1) ? args[0] : CASCADE_FILE_NAME;
+    var sourceFile  = (args.Count() == 2) ? args[1] : COMPILED_CASCADE_FILE_NAME;
+
+    if (File::Exists(cascadeFile) == false)
+        throw ArgumentException("The specified cascade does not exist: " + cascadeFile);
+
+    var cascade = Cascade::FromFile(cascadeFile);
+    Console::WriteLine((string)"Cascade: " + cascadeFile + " (trees: " + (int)cascade.Trees.Count() + ", stages: " + cascade.StageCount() + ")");
+
+    CompileCascade(cascade, sourceFile, cascadeFile);
+    Console::WriteLine((string)"Source written to: " + sourceFile);
+    Console::WriteLine((string)"Copy it beside Test.hpp (src/ViolaJones/Test/) and re-build the Test app.");
+}
+
+int main(int argCount, char* argValues[])
+{
+    Console::ForegroundColor = ConsoleColor::Green;
+    Console::WriteLine((string)"Cascade compiler (Viola Jones) - generates a C++ source of a trained cascade.");
+
+    Console::ForegroundColor = ConsoleColor::Yellow;
+    Console::WriteLine((string)"Arguments: [cascade path] = 'cascade.bin' [output path] = 'CompiledCascade.hpp'");
+    Console::WriteLine((string)"\tExample: 'Compile cascade.bin ../src/ViolaJones/Test/CompiledCascade.hpp'");
+    Console::WriteLine();
+
+    Console::ForegroundColor = ConsoleColor::Default;
+
+    try
+    {
+        var arguments = GetArguments(argCount, argValues);
+        RunApp(arguments);
+    }
+    catch (Exception& ex)
+    {
+        Console::Error(ex);
+        return -1;
+    }
+    
+    return 0;
+}
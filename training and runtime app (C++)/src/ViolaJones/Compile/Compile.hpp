@@ -0,0 +1,164 @@
+#pragma once
+
+#include "../Shared/Cascade.hpp"
+#include "../Shared/Config.hpp"
+
+namespace ViolaJones
+{
+    /// @brief Converts a float into a C++ float literal which is parsed back into the same value.
+    /// @param value Value to convert.
+    /// @return Float literal.
+    static string FloatLiteral(float value)
+    {
+        char buff[64] = { '\0' };
+        sprintf(buff, "%.9ef", value);
+        return string(buff);
+    }
+
+    /// @brief Writes a source line with the specified indentation.
+    /// @param fs Target stream.
+    /// @param indent Indentation level (4 spaces each).
+    /// @param line Source line.
+    static void WriteSourceLine(FileStream& fs, int indent, const string& line)
+    {
+        fs.WriteLine(((string)" " * (indent * 4)) + line);
+    }
+
+    /// @brief Writes a tree node (and its children recursively) as nested if-else statements where each leaf is a return statement.
+    /// @param fs Target stream.
+    /// @param tree Tree to write.
+    /// @param nodeIdx Current node index.
+    /// @param depth Current depth.
+    /// @param treeDepth Tree depth.
+    /// @param indent Indentation level.
+    static void WriteTreeNode(FileStream& fs, Tree& tree, int nodeIdx, int depth, int treeDepth, int indent)
+    {
+        if (depth == treeDepth)
+        {
+            var leafIdx = nodeIdx - ((int)Math::Pow(2, treeDepth) - 1);
+            WriteSourceLine(fs, indent, "return " + FloatLiteral(tree.Leafs[leafIdx]) + ";");
+            return;
+        }
+
+        var& n = tree.Nodes[nodeIdx];
+        WriteSourceLine(fs, indent, (string)"if (PX(" + (int)n.RowA + ", " + (int)n.ColA + ", " + (int)n.RowB + ", " + (int)n.ColB + "))");
+        WriteSourceLine(fs, indent, "{");
+        WriteTreeNode(fs, tree, nodeIdx * 2 + 2, depth + 1, treeDepth, indent + 1); //go right
+        WriteSourceLine(fs, indent, "}");
+        WriteSourceLine(fs, indent, "else");
+        WriteSourceLine(fs, indent, "{");
+        WriteTreeNode(fs, tree, nodeIdx * 2 + 1, depth + 1, treeDepth, indent + 1); //go left
+        WriteSourceLine(fs, indent, "}");
+    }
+
+    /// @brief Generates a C++ source (header) file where the cascade is hard-coded: every pixel offset and leaf value is an immediate constant,
+    ///        trees are unrolled into if-else statements and stage checks are unrolled as well.
+    ///        The output is meant to be placed beside Test.hpp (as CompiledCascade.hpp) and compiled into the Test app.
+    /// @param cascade Cascade to compile.
+    /// @param sourceFile Target source file.
+    /// @param cascadeName Cascade name written in the header comment.
+    void CompileCascade(Cascade& cascade, const string& sourceFile, const string& cascadeName)
+    {
+        var fs = FileStream(sourceFile, FileMode::WriteOnly);
+        var treeCount = (int)cascade.Trees.Count();
+
+        WriteSourceLine(fs, 0, "#pragma once");
+        WriteSourceLine(fs, 0, "//Generated by the Compile app from: '" + cascadeName + "'. Do not edit - re-generate it instead.");
+        WriteSourceLine(fs, 0, "#include <opencv2/core.hpp>");
+        WriteSourceLine(fs, 0, "");
+        WriteSourceLine(fs, 0, "//row (or column) of a normalized coordinate within a patch (the same computation as in EvalFeature)");
+        WriteSourceLine(fs, 0, "#define RC(x, size) (((size / 2) * 256 + (x) * size) / 256)");
+        WriteSourceLine(fs, 0, "//pixel comparison of a single node");
+        WriteSourceLine(fs, 0, "#define PX(rA, cA, rB, cB) (p[RC(rA, pH) * stride + RC(cA, pW)] <= p[RC(rB, pH) * stride + RC(cB, pW)])");
+        WriteSourceLine(fs, 0, "//the quality tier evaluator (ClassifyPatch with rejection bounds) is generated");
+        WriteSourceLine(fs, 0, "#define COMPILED_CASCADE_TIERS 1");
+        WriteSourceLine(fs, 0, "");
+        WriteSourceLine(fs, 0, "namespace ViolaJones::CompiledCascade");
+        WriteSourceLine(fs, 0, "{");
+        WriteSourceLine(fs, 1, "/// @brief Checksum of the source cascade (see Cascade::Checksum).");
+        WriteSourceLine(fs, 1, "const UInt32 CHECKSUM = " + String((UInt64)cascade.Checksum()) + "u;");
+        WriteSourceLine(fs, 1, "/// @brief Tree count of the source cascade.");
+        WriteSourceLine(fs, 1, (string)"const int TREE_COUNT = " + treeCount + ";");
+        WriteSourceLine(fs, 0, "");
+
+        //trees
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
+        {
+            WriteSourceLine(fs, 1, (string)"static inline float Tree" + treeIdx + "(const byte* p, int stride, int pW, int pH)");
+            WriteSourceLine(fs, 1, "{");
+            WriteTreeNode(fs, cascade.Trees[treeIdx], 0, 0, cascade.TreeDepth, 2);
+            WriteSourceLine(fs, 1, "}");
+            WriteSourceLine(fs, 0, "");
+        }
+
+        //tree table (used for the equivalence check only)
+        WriteSourceLine(fs, 1, "using TreeFunc = float(*)(const byte* p, int stride, int pW, int pH);");
+        WriteSourceLine(fs, 1, "/// @brief All trees in the cascade order.");
+        WriteSourceLine(fs, 1, "const TreeFunc TREES[] =");
+        WriteSourceLine(fs, 1, "{");
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
+            WriteSourceLine(fs, 2, (string)"Tree" + treeIdx + ",");
+        WriteSourceLine(fs, 1, "};");
+        WriteSourceLine(fs, 0, "");
+
+        //cascade (unrolled stages)
+        WriteSourceLine(fs, 1, "/// @brief Classifies a single patch (positive vs negative). Equivalent to the interpreted ClassifyPatch.");
+        WriteSourceLine(fs, 1, "inline bool ClassifyPatch(cv::Mat& patch, float& confidence)");
+        WriteSourceLine(fs, 1, "{");
+        WriteSourceLine(fs, 2, "const byte* p = patch.data;");
+        WriteSourceLine(fs, 2, "const int stride = (int)patch.step;");
+        WriteSourceLine(fs, 2, "const int pW = patch.cols;");
+        WriteSourceLine(fs, 2, "const int pH = patch.rows;");
+        WriteSourceLine(fs, 2, "confidence = 0.0f;");
+        WriteSourceLine(fs, 0, "");
+
+        //rejection bounds (stage thresholds reduced by the max remaining leaf sum) - the same as for the interpreted cascade
+        cascade.UpdateRejectBounds();
+
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
+        {
+            WriteSourceLine(fs, 2, (string)"confidence += Tree" + treeIdx + "(p, stride, pW, pH);");
+
+            //trees without a bound (-1000) never reject a patch
+            var bound = cascade.RejectBounds[treeIdx];
+            if (bound < -999.0f)
+                continue;
+
+            WriteSourceLine(fs, 2, "if (confidence < " + FloatLiteral(bound) + ") return false;");
+        }
+        WriteSourceLine(fs, 0, "");
+
+        WriteSourceLine(fs, 2, "return true;");
+        WriteSourceLine(fs, 1, "}");
+        WriteSourceLine(fs, 0, "");
+
+        //quality tier (the first trees with rejection bounds computed at runtime, see Cascade::GetRejectBounds)
+        WriteSourceLine(fs, 1, "/// @brief Classifies a single patch using the first trees of the cascade and their rejection bounds (quality tier). Equivalent to the interpreted EvalCascade for a tier.");
+        WriteSourceLine(fs, 1, "inline bool ClassifyPatch(cv::Mat& patch, float& confidence, int treeCount, const float* bounds)");
+        WriteSourceLine(fs, 1, "{");
+        WriteSourceLine(fs, 2, "const byte* p = patch.data;");
+        WriteSourceLine(fs, 2, "const int stride = (int)patch.step;");
+        WriteSourceLine(fs, 2, "const int pW = patch.cols;");
+        WriteSourceLine(fs, 2, "const int pH = patch.rows;");
+        WriteSourceLine(fs, 2, "confidence = 0.0f;");
+        WriteSourceLine(fs, 0, "");
+
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
+        {
+            WriteSourceLine(fs, 2, (string)"confidence += Tree" + treeIdx + "(p, stride, pW, pH);");
+            WriteSourceLine(fs, 2, (string)"if (confidence < bounds[" + treeIdx + "]) return false;");
+            if (treeIdx < treeCount - 1)
+                WriteSourceLine(fs, 2, (string)"if (treeCount == " + (treeIdx + 1) + ") return true;");
+        }
+        WriteSourceLine(fs, 0, "");
+
+        WriteSourceLine(fs, 2, "return true;");
+        WriteSourceLine(fs, 1, "}");
+        WriteSourceLine(fs, 0, "}");
+        WriteSourceLine(fs, 0, "");
+        WriteSourceLine(fs, 0, "#undef PX");
+        WriteSourceLine(fs, 0, "#undef RC");
+
+        fs.Close();
+    }
+}
@@ -0,0 +1,68 @@
+#define PARALLEL 1 //decode images in parallel
+
+#include "Pack.hpp"
+#include <Extensions/ConsoleExtensions.h>
+
+using namespace System;
+using namespace ViolaJones;
+
+/// @brief Runs the app - parses the arguments and packs a database folder into a single file.
+/// @param args Console args.
+static void RunApp(List<string>& args)
+{
+    if (args.Count() < 1 || args.Count() > 4)
+        throw Exception((string)"Invalid number of arguments.");
+
+    var dbPath       = args[0];
+    var maxImageSize = (args.Count() >= 2) ? String::ParseInt32(args[1]) : 0;
+    var compressName = (args.Count() >= 3) ? args[2] : (string)"none";
+    var outFile      = (args.Count() == 4) ? args[3] : Path::Combine(dbPath, PACKED_DATASET_FILE_NAME);
+
+    if (Directory::Exists(dbPath) == false)
+        throw ArgumentException("The specified database folder does not exist: " + dbPath);
+
+    if (maxImageSize < 0)
+        throw ArgumentException((string)"The max image size must not be negative.");
+
+    PackedCompression compression;
+    if (compressName == "none")
+        compression = PackedCompression::None;
+    else if (compressName == "png")
+        compression = PackedCompression::Png;
+    else
+        throw ArgumentException("Unsupported compression: " + compressName + ". Supported: none, png.");
+
+    //the folder content is always scanned (an existing packed file is replaced)
+    Console::WriteLine((string)"Dataset:");
+    var set = LabeledDataset(dbPath, -1, 0, false);
+
+    var size = PackDataset(set, dbPath, outFile, maxImageSize, compression);
+    Console::WriteLine((string)"Packed dataset written to: " + outFile + " (" + String((double)size / (1024 * 1024), 1) + " MB)");
+}
+
+int main(int argCount, char* argValues[])
+{
+    Console::ForegroundColor = ConsoleColor::Green;
+    Console::WriteLine((string)"Dataset packing (Viola Jones) - converts a database folder into a single memory mapped file of grayscale images and ROIs.");
+
+    Console::ForegroundColor = ConsoleColor::Yellow;
+    Console::WriteLine((string)"Arguments: <database path> [max image size] = 0 (original size) [compression] = 'none' | 'png' [output path] = '<database path>/dataset.pack'");
+    Console::WriteLine((string)"\tExample: 'Pack database/ 640 none'");
+    Console::WriteLine((string)"If '<database path>/dataset.pack' exists, the Train and Calibrate apps read it instead of the folder content.");
+    Console::WriteLine();
+
+    Console::ForegroundColor = ConsoleColor::Default;
+
+    try
+    {
+        var arguments = GetArguments(argCount, argValues);
+        RunApp(arguments);
+    }
+    catch (Exception& ex)
+    {
+        Console::Error(ex);
+        return -1;
+    }
+
+    return 0;
+}
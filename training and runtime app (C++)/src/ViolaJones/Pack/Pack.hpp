@@ -0,0 +1,193 @@
+#pragma once
+
+#include "../Shared/Config.hpp"
+#include "../Train/Dataset/Dataset.hpp"
+#include <System.Threading.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <vector>
+
+using namespace System::Threading;
+
+namespace ViolaJones
+{
+    /// @brief Pixel data of a packed image.
+    struct PackedImageData
+    {
+        /// @brief Raw pixels or the encoded image.
+        List<byte> Data;
+        int Rows = 0;
+        int Cols = 0;
+    };
+
+    /// @brief Reads an image as grayscale, downscales it if needed and converts it to the packed storage.
+    /// @param imFile Image file.
+    /// @param maxImageSize Max image side (the image is downscaled if larger). If 0, the image is kept as is.
+    /// @param compression Storage of the packed image.
+    /// @return Packed image data.
+    static PackedImageData PackImage(const string& imFile, int maxImageSize, PackedCompression compression)
+    {
+        var im = cv::imread(cv::String(imFile.Ptr(), imFile.Length()), cv::IMREAD_GRAYSCALE);
+        if (im.empty())
+            throw Exception("Can not open the specified image: " + imFile);
+
+        var maxSide = Math::Max(im.rows, im.cols);
+        if (maxImageSize > 0 && maxSide > maxImageSize)
+        {
+            var scale = (double)maxImageSize / maxSide;
+            var size = cv::Size(Math::Max(1, (int)Math::Round(im.cols * scale)), Math::Max(1, (int)Math::Round(im.rows * scale)));
+            cv::resize(im, im, size, 0, 0, cv::INTER_AREA);
+        }
+
+        var packedIm = PackedImageData();
+        packedIm.Rows = im.rows;
+        packedIm.Cols = im.cols;
+
+        if (compression == PackedCompression::Png)
+        {
+            var buffer = std::vector<byte>();
+            cv::imencode(".png", im, buffer, { cv::IMWRITE_PNG_COMPRESSION, 1 }); //fast decoding is preferred over the size
+            packedIm.Data.Add(0, buffer.size());
+            memcpy(packedIm.Data.begin(), buffer.data(), buffer.size());
+        }
+        else
+        {
+            packedIm.Data.Add(0, (long)im.rows * im.cols);
+            for (var r = 0; r < im.rows; r++)
+                memcpy(packedIm.Data.begin() + (long)r * im.cols, im.ptr<byte>(r), im.cols);
+        }
+
+        return packedIm;
+    }
+
+    using PackImagesArgs = Tuple<LabeledDataset&, int, int, PackedCompression, List<PackedImageData>&>;
+
+    /// @brief Packs a batch of images (in parallel if enabled).
+    /// @param set Dataset (image files).
+    /// @param start Index of the first image.
+    /// @param maxImageSize Max image side (see PackImage).
+    /// @param compression Storage of the packed images.
+    /// @param batch Packed images (its size is the number of images to pack).
+    static void PackImages(LabeledDataset& set, int start, int maxImageSize, PackedCompression compression, List<PackedImageData>& batch)
+    {
+#ifndef PARALLEL
+        for (var i = 0; i < batch.Count(); i++)
+            batch[i] = PackImage(set.ImageFile(start + i), maxImageSize, compression);
+#else
+        var args = PackImagesArgs(set, start, maxImageSize, compression, batch);
+        Parallel<PackImagesArgs>::For(0, batch.Count(), [](PackImagesArgs args, long i, bool& shouldCancel)
+        {
+            var& [set, start, maxImageSize, compression, batch] = args;
+            batch[i] = PackImage(set.ImageFile(start + i), maxImageSize, compression);
+        },
+        args);
+#endif
+    }
+
+    /// @brief Writes a value into a packed file and moves the offset.
+    /// @param fs Target stream.
+    /// @param offset Current file offset (tracked as a 64-bit value, packed files may exceed 2GB).
+    /// @param value Value.
+    TC static void WritePackedValue(FileStream& fs, Int64& offset, T value)
+    {
+        fs.WriteValue(value);
+        offset += sizeof(T);
+    }
+
+    /// @brief Writes a string prefixed by its length into a packed file and moves the offset.
+    /// @param fs Target stream.
+    /// @param offset Current file offset.
+    /// @param str String.
+    static void WritePackedString(FileStream& fs, Int64& offset, const string& str)
+    {
+        WritePackedValue(fs, offset, (Int32)str.Length());
+        fs.Write((byte*)str.Ptr(), str.Length());
+        offset += str.Length();
+    }
+
+    /// @brief Packs a database folder into a single file (see PackedDataset for the layout). Images are converted in parallel batches and written in order.
+    ///        Stamps of the folder (see PackedSource) are taken before the images are read, so a change during packing is detected when the packed file is used.
+    /// @param set Dataset (image files and object ROIs as labeled - without an enforced width height ratio).
+    /// @param dbFolder Database folder the dataset was read from.
+    /// @param outFile Packed file.
+    /// @param maxImageSize Max image side (larger images are downscaled). If 0, images are kept in their original size.
+    /// @param compression Storage of the packed images.
+    /// @return Size of the packed file (bytes).
+    Int64 PackDataset(LabeledDataset& set, const string& dbFolder, const string& outFile, int maxImageSize, PackedCompression compression)
+    {
+        var imageFiles = List<string>();
+        for (var i = 0; i < set.ImageCount(); i++)
+            imageFiles.Add(set.ImageFile(i));
+
+        var source = PackedSource::Create(dbFolder, imageFiles);
+
+        var fs = FileStream(outFile, FileMode::WriteOnly);
+        var offset = (Int64)0;
+
+        WritePackedValue(fs, offset, PACKED_DATASET_MAGIC);
+        WritePackedValue(fs, offset, PACKED_DATASET_VERSION);
+        WritePackedValue(fs, offset, (Int32)compression);
+
+        var index = List<PackedImage>();
+        byte padding[64] = { 0 };
+
+        for (var start = 0; start < set.ImageCount(); start += PACK_BATCH_SIZE)
+        {
+            var batch = List<PackedImageData>();
+            batch.Add(PackedImageData(), Math::Min(PACK_BATCH_SIZE, set.ImageCount() - start));
+            PackImages(set, start, maxImageSize, compression, batch);
+
+            for (var& packedIm: batch)
+            {
+                //image data are 64-byte aligned
+                var paddingSize = (int)((64 - offset % 64) % 64);
+                fs.Write(padding, paddingSize);
+                offset += paddingSize;
+
+                var entry = PackedImage { .Offset = offset, .Size = packedIm.Data.Count(), .Rows = packedIm.Rows, .Cols = packedIm.Cols };
+                index.Add(entry);
+
+                fs.Write(packedIm.Data.begin(), packedIm.Data.Count());
+                offset += packedIm.Data.Count();
+            }
+
+            Console::Progress((float)(start + batch.Count()) / set.ImageCount(), (string)"\tPacking images...");
+        }
+
+        //index
+        var indexOffset = offset;
+        WritePackedValue(fs, offset, (Int32)index.Count());
+
+        for (var i = 0; i < index.Count(); i++)
+        {
+            WritePackedValue(fs, offset, index[i].Offset);
+            WritePackedValue(fs, offset, index[i].Size);
+            WritePackedValue(fs, offset, index[i].Rows);
+            WritePackedValue(fs, offset, index[i].Cols);
+
+            var& rois = set.GetObjects(i);
+            WritePackedValue(fs, offset, (Int32)rois.Count());
+            for (var& roi: rois)
+                WritePackedValue(fs, offset, roi);
+        }
+
+        //source stamps
+        WritePackedValue(fs, offset, source.RootImageCount);
+        WritePackedValue(fs, offset, (Int32)source.Folders.Count());
+        for (var i = 0; i < source.Folders.Count(); i++)
+        {
+            WritePackedString(fs, offset, source.Folders[i]);
+            WritePackedValue(fs, offset, source.FolderStamps[i]);
+        }
+
+        for (var i = 0; i < source.ImageFiles.Count(); i++)
+        {
+            WritePackedString(fs, offset, source.ImageFiles[i]);
+            WritePackedValue(fs, offset, source.LabelStamps[i]);
+        }
+
+        WritePackedValue(fs, offset, indexOffset);
+        return offset;
+    }
+}
@@ -12,6 +12,15 @@ using namespace System::IO;
 
 namespace ViolaJones
 {
+    /// @brief Scales a rejection threshold: T + (1 - scale) * |T|. 
+    /// @param threshold Threshold.
+    /// @param scale Threshold scale.
+    /// @return Scaled threshold.
+    static float ScaleThreshold(float threshold, float scale)
+    {
+        return threshold + (1 - scale) * Math::Abs(threshold);
+    }
+
     /// @brief An internal node of a tree.
     struct Node
     {
@@ -36,6 +45,15 @@ namespace ViolaJones
         int TreeDepth = 0;
         float WidthHeightRatio = 0;
         List<Tree> Trees;
+        /// @brief Index of the last tree of each stage. 
+        ///        Stored only for soft cascades (where intermediate trees have thresholds as well); otherwise derived from tree thresholds.
+        List<int> StageEnds;
+
+        /// @brief Runtime only (not stored): true if a compiled (generated) evaluator is used instead of the tree data.
+        bool IsCompiled = false;
+        /// @brief Runtime only (not stored): rejection bound of each tree - a window is rejected as soon as its confidence is below the bound.
+        ///        Valid only if its count equals the tree count (see UpdateRejectBounds).
+        List<float> RejectBounds;
 
         /// @brief Loads a cascade if exists (and modified config), or creates a new one using provided config.
         /// @param file Cascade file path.
@@ -66,7 +84,11 @@ namespace ViolaJones
         {
             var fs = FileStream(file, FileMode::WriteOnly);
 
-            fs.WriteValue((float)1);
+            //soft cascades can not be split into stages by thresholds: the version is increased and stage ends are appended after the trees
+            //(readers of the version 1 ignore both the first value and the trailing data)
+            var isSoftCascade = IsSoftCascade();
+
+            fs.WriteValue(isSoftCascade ? (float)2 : (float)1);
             fs.WriteValue(this->WidthHeightRatio);
             fs.WriteValue(this->TreeDepth);
             fs.WriteValue((int)this->Trees.Count());
@@ -88,6 +110,13 @@ namespace ViolaJones
                 fs.WriteValue(tree.Threshold);
             }
 
+            if (isSoftCascade)
+            {
+                fs.WriteValue((int)this->StageEnds.Count());
+                for (var stageEnd: this->StageEnds)
+                    fs.WriteValue(stageEnd);
+            }
+
             fs.Close();
         }
 
@@ -95,17 +124,134 @@ namespace ViolaJones
         /// @return Stage count.
         int StageCount()
         {
-            var nStages = 0;
+            return this->StageEnds.Count();
+        }
+
+        /// @brief Gets the number of trees of the first stages.
+        /// @param stageCount Number of stages. If 0 or not smaller than the stage count, all trees are counted.
+        /// @return Tree count.
+        int StageTreeCount(int stageCount)
+        {
+            if (stageCount > 0 && stageCount < this->StageCount())
+                return this->StageEnds[stageCount - 1] + 1;
+
+            return this->Trees.Count();
+        }
+
+        /// @brief Checks whether a tree is the last tree of a stage.
+        /// @param treeIdx Tree index.
+        /// @return True if the tree ends a stage, false otherwise.
+        bool IsStageEnd(int treeIdx)
+        {
+            return this->StageEnds.Contains(treeIdx);
+        }
+
+        /// @brief Checks whether the cascade is a soft cascade: its stages can not be derived from tree thresholds (intermediate trees have thresholds as well).
+        /// @return True if the cascade is a soft cascade, false otherwise.
+        bool IsSoftCascade()
+        {
+            var stageEnds = StageEndsFromThresholds(this->Trees);
+            if (stageEnds.Count() != this->StageEnds.Count())
+                return true;
+
+            for (var i = 0; i < stageEnds.Count(); i++)
+            {
+                if (stageEnds[i] != this->StageEnds[i])
+                    return true;
+            }
+
+            return false;
+        }
+
+        /// @brief Calculates the rejection bound of each tree: the threshold of the next stage minus the max leaf sum the remaining trees of the stage can add.
+        ///        A window whose confidence is below the bound can not reach the stage threshold, so the decisions are identical to the threshold-only evaluation.
+        ///        Must be called whenever trees or thresholds are modified.
+        void UpdateRejectBounds()
+        {
+            this->RejectBounds = GetRejectBounds(this->Trees.Count());
+        }
+
+        /// @brief Calculates rejection bounds (see UpdateRejectBounds) of the first trees evaluated with scaled thresholds, e.g. for a quality tier.
+        /// @param treeCount Number of evaluated (first) trees - the last one must end a stage.
+        /// @param thresholdScale Threshold scale (see ScaleThreshold).
+        /// @return Rejection bound of each evaluated tree.
+        List<float> GetRejectBounds(int treeCount, float thresholdScale = 1.0f)
+        {
+            var bounds = List<float>();
+            bounds.Add(-1000.0f, treeCount);
+
+            var nextBound = -1000.0f; //-1000: no bound (no stage threshold ahead)
+            for (var treeIdx = treeCount - 1; treeIdx >= 0; treeIdx--)
+            {
+                var bound = this->Trees[treeIdx].Threshold;
+                if (bound > -999.0f)
+                    bound = ScaleThreshold(bound, thresholdScale);
+
+                if (nextBound > -999.0f)
+                {
+                    var maxLeaf = this->Trees[treeIdx + 1].Leafs[0];
+                    for (var leaf: this->Trees[treeIdx + 1].Leafs)
+                        maxLeaf = Math::Max(maxLeaf, leaf);
+
+                    //small margin covers float rounding of the confidence accumulation
+                    var margin = 1e-5f * (Math::Abs(nextBound) + Math::Abs(maxLeaf) + 1);
+                    bound = Math::Max(bound, nextBound - maxLeaf - margin);
+                }
+
+                bounds[treeIdx] = bound;
+                nextBound = bound;
+            }
+
+            return bounds;
+        }
+
+        /// @brief Calculates a checksum (FNV-1a) of the cascade content. Used to match a cascade with its compiled version.
+        /// @return Checksum.
+        UInt32 Checksum()
+        {
+            var hash = (UInt32)2166136261u;
+            var hashBytes = [](UInt32 hash, void* ptr, int count)
+            {
+                var bytes = (byte*)ptr;
+                for (var i = 0; i < count; i++)
+                    hash = (hash ^ bytes[i]) * 16777619u;
+
+                return hash;
+            };
+
+            hash = hashBytes(hash, &this->WidthHeightRatio, sizeof(float));
+            hash = hashBytes(hash, &this->TreeDepth, sizeof(int));
 
             for (var& tree: this->Trees)
             {
-                if (tree.Threshold < -999.0f)
+                for (var& node: tree.Nodes)
+                    hash = hashBytes(hash, &node, sizeof(Node));
+
+                for (var& leaf: tree.Leafs)
+                    hash = hashBytes(hash, &leaf, sizeof(float));
+
+                hash = hashBytes(hash, &tree.Threshold, sizeof(float));
+            }
+
+            return hash;
+        }
+
+        /// @brief Gets stage ends of a (non-soft) cascade: only the last tree of each stage has a threshold.
+        /// @param trees Cascade trees.
+        /// @return Index of the last tree of each stage.
+        static List<int> StageEndsFromThresholds(List<Tree>& trees)
+        {
+            var stageEnds = List<int>();
+
+            for (var treeIdx = 0; treeIdx < trees.Count(); treeIdx++)
+            {
+                if (trees[treeIdx].Threshold < -999.0f)
                     continue;
 
-                nStages++;
+                stageEnds.Add(treeIdx);
             }
 
-            return nStages;
+            return stageEnds;
         }
 
         /// @brief  Loads a cascade from a file.
@@ -116,7 +262,7 @@ namespace ViolaJones
             Cascade cascade;
             var fs = FileStream(file, FileMode::ReadOnly);
 
-            var rowScale = fs.ReadValue<float>();
+            var version = fs.ReadValue<float>();
             var colScale = fs.ReadValue<float>();
             var treeDepth = fs.ReadValue<int>();
             var treeCount = fs.ReadValue<int>();
@@ -152,7 +298,18 @@ namespace ViolaJones
                 cascade.Trees.Add(tree);
             }
 
+            if (version >= 2)
+            {
+                var stageCount = fs.ReadValue<int>();
+                for (var stageIdx = 0; stageIdx < stageCount; stageIdx++)
+                    cascade.StageEnds.Add(fs.ReadValue<int>());
+            }
+            else
+                cascade.StageEnds = StageEndsFromThresholds(cascade.Trees);
+
             fs.Close();
+
+            cascade.UpdateRejectBounds();
             return cascade;
         }
     };
@@ -24,6 +24,32 @@ namespace ViolaJones
         float MaxFPR = 1e-3;
         /// @brief Minimum TPR to retain for each stage.
         List<float> MinTPRs = { 0.980f, 0.990f, 0.995f, 0.995f, 0.997f, 0.997f, 0.997f, 0.997f, 0.997f, 0.997f, 0.997f, 0.997f, 0.997f };
+        /// @brief True to calibrate a rejection threshold after each tree (soft cascade), false to set only a threshold per stage.
+        bool SoftCascade = false;
+        /// @brief Height of the canonical grid training samples are resampled to (the width follows the width / height ratio, see SampleStore::GridCols).
+        ///        Small grids keep the sample memory low, but approximate the detector pixel reads (trees and thresholds are then fitted to slightly different reads than the detector makes).
+        ///        256 is the opt-in exact mode - it reproduces the detector reads, but a sample takes 64 kB (required by the negative pool).
+        int SampleSize = 64;
+        /// @brief Number of random candidate features per tree node.
+        int FeatureCount = 1024;
+        /// @brief True to search node features by successive halving (on growing weighted subsets of samples), false to evaluate all candidates on all node samples.
+        bool SuccessiveHalving = false;
+        /// @brief True to mine negatives by scanning whole negative images with the detector (all windows, all scales), false to classify a random patch per request.
+        bool DenseMining = false;
+        /// @brief Memory budget (MB) of the decoded image cache of each dataset (positive and negative). If 0, images are decoded for each patch.
+        int ImageCacheMB = 1024;
+        /// @brief Max object height (px) of cached positive crops (larger objects are downscaled, except with the exact sample size 256). If 0, positives are not cached and each one is cut from its (decoded) image.
+        ///        Downscaled crops give area-averaged pixels instead of the ones the detector reads, hence the cache is opt-in.
+        int PositiveCropSize = 0;
+        /// @brief Number of I/O threads reading and decoding negative images ahead of the sampling.
+        int PrefetchThreads = 2;
+        /// @brief Max number of negative images read ahead (queued or being read). If 0, images are read by the sampling threads.
+        int PrefetchDepth = 32;
+        /// @brief True to carry the mined negatives over to the next stage (the ones the new stage does not reject are reused), false to mine all negatives of each stage anew.
+        ///        Requires the exact sample size (256).
+        bool NegativePool = false;
+        /// @brief Number of features of the stage feature pool nodes pick their candidates from. If 0, candidates are drawn per node.
+        int FeaturePool = 0;
         
         /// @brief Loads (if exists) or creates a config file.
         /// @param dbPath Database path - config file name is predefined.
@@ -64,6 +90,17 @@ namespace ViolaJones
             str = str + ((string)"maxTreeCount:").PadRight(PADDING)     + MaxTreeCount                + (string)"\n";
             str = str + ((string)"maxFPR:").PadRight(PADDING)           + String(MaxFPR, 5)           + (string)"\n";
             str = str + ((string)"minTPRs:").PadRight(PADDING)          + minTPRsStr                  + (string)"\n";
+            str = str + ((string)"softCascade:").PadRight(PADDING)      + (int)SoftCascade            + (string)"\n";
+            str = str + ((string)"sampleSize:").PadRight(PADDING)       + SampleSize                  + (string)"\n";
+            str = str + ((string)"featureCount:").PadRight(PADDING)     + FeatureCount                + (string)"\n";
+            str = str + ((string)"successiveHalving:").PadRight(PADDING) + (int)SuccessiveHalving     + (string)"\n";
+            str = str + ((string)"featurePool:").PadRight(PADDING)      + FeaturePool                 + (string)"\n";
+            str = str + ((string)"denseMining:").PadRight(PADDING)      + (int)DenseMining            + (string)"\n";
+            str = str + ((string)"imageCacheMB:").PadRight(PADDING)     + ImageCacheMB                + (string)"\n";
+            str = str + ((string)"positiveCropSize:").PadRight(PADDING) + PositiveCropSize            + (string)"\n";
+            str = str + ((string)"prefetchThreads:").PadRight(PADDING)  + PrefetchThreads             + (string)"\n";
+            str = str + ((string)"prefetchDepth:").PadRight(PADDING)    + PrefetchDepth               + (string)"\n";
+            str = str + ((string)"negativePool:").PadRight(PADDING)     + (int)NegativePool           + (string)"\n";
 
             return str;
         }
@@ -161,6 +198,97 @@ namespace ViolaJones
                 }
             }
 
+            //softCascade
+            keyIdx = keys.FindIndex("softCascade");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.SoftCascade = ValidateValue(val, 0, 1, "softCascade") == 1;
+            }
+
+            //sampleSize
+            keyIdx = keys.FindIndex("sampleSize");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.SampleSize = ValidateValue(val, 8, 256, "sampleSize");
+            }
+
+            //featureCount
+            keyIdx = keys.FindIndex("featureCount");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.FeatureCount = ValidateValue(val, 16, 65536, "featureCount");
+            }
+
+            //successiveHalving
+            keyIdx = keys.FindIndex("successiveHalving");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.SuccessiveHalving = ValidateValue(val, 0, 1, "successiveHalving") == 1;
+            }
+
+            //featurePool
+            keyIdx = keys.FindIndex("featurePool");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.FeaturePool = ValidateValue(val, 0, 65536, "featurePool");
+            }
+
+            //denseMining
+            keyIdx = keys.FindIndex("denseMining");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.DenseMining = ValidateValue(val, 0, 1, "denseMining") == 1;
+            }
+
+            //imageCacheMB
+            keyIdx = keys.FindIndex("imageCacheMB");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.ImageCacheMB = ValidateValue(val, 0, 1024 * 1024, "imageCacheMB");
+            }
+
+            //positiveCropSize
+            keyIdx = keys.FindIndex("positiveCropSize");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.PositiveCropSize = ValidateValue(val, 0, 4096, "positiveCropSize");
+            }
+
+            //prefetchThreads
+            keyIdx = keys.FindIndex("prefetchThreads");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.PrefetchThreads = ValidateValue(val, 1, 64, "prefetchThreads");
+            }
+
+            //prefetchDepth
+            keyIdx = keys.FindIndex("prefetchDepth");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.PrefetchDepth = ValidateValue(val, 0, 4096, "prefetchDepth");
+            }
+
+            //negativePool
+            keyIdx = keys.FindIndex("negativePool");
+            if (keyIdx != -1)
+            {
+                var val = String::ParseInt32(values[keyIdx]);
+                config.NegativePool = ValidateValue(val, 0, 1, "negativePool") == 1;
+            }
+
+            if (config.PrefetchDepth > 0 && config.PrefetchDepth < config.PrefetchThreads)
+                throw ArgumentException((string)"Config file: prefetchDepth must not be smaller than prefetchThreads.");
+
             return config;
         }
 
@@ -180,14 +308,101 @@ namespace ViolaJones
     //----train
     /// @brief Default database path (if not specified by cmd arguments).
     const static string DATABASE_PATH = "database/";
+    /// @brief Packed dataset file name (see the Pack app). If the file exists in a database folder, it is used instead of the folder content.
+    const static string PACKED_DATASET_FILE_NAME = "dataset.pack";
+    /// @brief Dataset manifest file name (written into a database folder, see DatasetManifest).
+    const static string DATASET_MANIFEST_FILE_NAME = "dataset.manifest";
     /// @brief Number of random features to generate while training a single node.
     const int RANDOM_FEATURE_COUNT = 1024;
 
+    /// @brief Node feature search options.
+    struct FeatureSearchOptions
+    {
+        /// @brief Number of random candidate features per node.
+        int FeatureCount = RANDOM_FEATURE_COUNT;
+        /// @brief If true, candidates are scored on a weighted random subset of node samples, the best ones are kept and re-scored on larger subsets until all node samples are used.
+        ///        If false, all candidates are evaluated on all node samples (exhaustive search).
+        bool IsSuccessiveHalving = false;
+        /// @brief Subset size (number of samples) of the first successive halving round.
+        int MinSampleCount = 256;
+        /// @brief Successive halving: the number of candidates is divided and the subset size multiplied by this factor after each round.
+        int ReductionFactor = 4;
+        /// @brief If not 0, a pool of this many random features is drawn and evaluated once per stage and each node picks its FeatureCount candidates from the pool
+        ///        (successive halving is not used then). The pool takes PoolSize * sampleCount / 8 bytes.
+        int PoolSize = 0;
+    };
+
+    /// @brief Max IOU of a negative patch (or a mined window) with a labeled object.
+    const float NEGATIVE_MAX_IOU = 0.5f;
+    /// @brief Dense mining: max IOU of a mined window with a labeled object. Lower than NEGATIVE_MAX_IOU, because detector windows are aligned around objects and near misses would teach the cascade to reject slightly shifted objects.
+    const float DENSE_MINING_MAX_IOU = 0.2f;
+    /// @brief Dense mining: max part of a labeled object covered by a mined window (windows containing an object are not negatives, even if their IOU is low).
+    const float DENSE_MINING_MAX_OBJECT_COVERAGE = 0.5f;
+    /// @brief Dense mining: max number of false positive windows taken from a single image (a random subset if there are more).
+    const int DENSE_MINING_MAX_PER_IMAGE = 64;
+
+    /// @brief Negative pool: min part of the stage negatives which is mined anew (not taken from the pool), so the stage FPR is always measured on the current cascade.
+    const float NEGATIVE_POOL_MIN_MINED_RATIO = 0.1f;
+
+    /// @brief Number of images negative patches are sampled from at a time (when the image cache is enabled or images are prefetched).
+    const int NEGATIVE_ACTIVE_IMAGES = 64;
+    /// @brief Number of negative patches sampled from an image before it is replaced by another random image (when the image cache is enabled).
+    const int NEGATIVE_PATCHES_PER_IMAGE = 32;
+    /// @brief Number of negative patches sampled from a prefetched image before it is replaced by the next prefetched image (prefetched images bypass the image cache).
+    const int NEGATIVE_PATCHES_PER_PREFETCHED_IMAGE = 32;
+
+    /// @brief Number of patches read and classified together (in parallel) while sampling training patches.
+    const int SAMPLING_BATCH_SIZE = 512;
+
+    /// @brief Number of trees trained for each feature search configuration by the training benchmark.
+    const int BENCHMARK_TREE_COUNT = 8;
+    /// @brief Every n-th image with objects is held out by the training benchmark - its objects are used for validation only (20 %).
+    const int BENCHMARK_VALIDATION_IMAGE_STEP = 5;
+
+    //----compile
+    /// @brief Default file name of a generated (compiled) cascade source.
+    const static string COMPILED_CASCADE_FILE_NAME = "CompiledCascade.hpp";
+
+    //----calibrate
+    /// @brief Default file name of a calibrated cascade.
+    const static string CALIBRATED_CASCADE_FILE_NAME = "cascade-calibrated.bin";
+    /// @brief Number of random negative windows (sampled from validation images) used to measure the cost (trees per window) during calibration.
+    const int CALIBRATION_NEGATIVE_COUNT = 20000;
+
+    //----pack
+    /// @brief Number of images read, converted and written together (images of a batch are converted in parallel).
+    const int PACK_BATCH_SIZE = 256;
+
     //----test
-    /// @brief Min scale factor (it multiplies image size) when detecting objects.
-    const float MIN_SCALE_FACTOR = 0.1f;
-    /// @brief Step (offset) scale multiplied by a current scale when scanning an image during detection.
-    const float STEP_SCALE = 0.1f;
-    /// @brief Scale increase - multiplies a previous scale. Used during object detection.
-    const float SCALE_INCREASE = 1.1f;
+    /// @brief Object detection (image scanning) options. Passed to each detection call.
+    struct DetectionOptions
+    {
+        /// @brief Min object (window) height in pixels. If 0, MinRelativeSize is used instead.
+        int MinSize = 0;
+        /// @brief Min object (window) height relative to the smaller image side. Used only if MinSize is 0.
+        float MinRelativeSize = 0.1f;
+        /// @brief Max object (window) height in pixels. If 0, the smaller image side is used.
+        int MaxSize = 0;
+        /// @brief Step (offset) fraction multiplied by a current scale when scanning an image.
+        float StepFraction = 0.1f;
+        /// @brief Scale increase - multiplies a previous scale.
+        float ScaleFactor = 1.1f;
+        /// @brief Max number of detections: each scan job (a part of a scale) stops when it reaches the limit and the first ones in the scale order are kept. If 0, the number is not limited.
+        int MaxDetections = 0;
+
+        /// @brief Number of evaluated (first) cascade stages - quality tier. If 0, all stages are evaluated.
+        int StageCount = 0;
+        /// @brief Stage threshold scale - quality tier. A threshold T is changed to T + (1 - scale) * |T|, which is T * scale for the usual negative thresholds.
+        ///        Values below 1 make stages stricter (faster, lower recall), values above 1 more permissive.
+        float ThresholdScale = 1.0f;
+        /// @brief Rejection bounds of the quality tier trees (see Cascade::GetRejectBounds), precomputed for the evaluated cascade (see QualityController). 
+        ///        If not set for a partial tier, they are computed by each detection call.
+        List<float> RejectBounds;
+    };
+
+    /// @brief Target detection time per video frame (ms) held by the quality controller (see QualityController.hpp). If 0, the full quality is always used.
+    const float VIDEO_TARGET_FRAME_MS = 40;
+
+    /// @brief Max number of frames (images) loaded into memory by the detection benchmark.
+    const int BENCHMARK_MAX_FRAMES = 500;
 }
\ No newline at end of file
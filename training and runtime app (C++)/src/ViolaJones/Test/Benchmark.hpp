@@ -0,0 +1,175 @@
+#pragma once
+
+#include "Test.hpp"
+#include <System.Diagnostics.h>
+
+using namespace System::Diagnostics;
+
+namespace ViolaJones
+{
+    /// @brief Detection benchmark result for a single thread count and a quality tier.
+    struct BenchmarkResult
+    {
+        int ThreadCount;
+        /// @brief Quality tier (0 - full quality, see QualityController).
+        int Tier;
+        /// @brief Number of measured frames (frames x iterations).
+        long FrameCount;
+        /// @brief Number of evaluated windows over all measured frames.
+        long WindowCount;
+        double WindowsPerSecond;
+        double NsPerWindow;
+        double DetectionsPerFrame;
+
+        double LatencyMeanMs;
+        double LatencyP50Ms;
+        double LatencyP90Ms;
+        double LatencyP99Ms;
+    };
+
+    /// @brief Gets a percentile (nearest rank) from sorted values.
+    /// @param sortedValues Values sorted in ascending order.
+    /// @param percentile Percentile [0..100].
+    /// @return Percentile value.
+    static double Percentile(List<double>& sortedValues, double percentile)
+    {
+        if (sortedValues.Count() == 0)
+            return 0;
+
+        var rank = (int)Math::Ceil(percentile / 100 * sortedValues.Count()) - 1;
+        rank = Math::Max(0, Math::Min(rank, (int)sortedValues.Count() - 1));
+        return sortedValues[rank];
+    }
+
+    /// @brief Runs object detection over the provided frames (no GUI) and measures its speed.
+    /// @param cascade Cascade to evaluate.
+    /// @param frames Grayscale frames.
+    /// @param threadCount Number of detection threads.
+    /// @param warmupIterations Number of iterations (over all frames) which are not measured.
+    /// @param iterations Number of measured iterations (over all frames).
+    /// @param options Detection options (quality tier).
+    /// @param tier Quality tier index (reported only).
+    /// @return Benchmark result.
+    BenchmarkResult BenchmarkDetection(Cascade& cascade, List<cv::Mat>& frames, int threadCount, int warmupIterations, int iterations, 
+                                       const DetectionOptions& options = DetectionOptions(), int tier = 0)
+    {
+        SetDetectionThreadCount(threadCount);
+
+        for (var i = 0; i < warmupIterations; i++)
+        {
+            for (var& frame: frames)
+                DetectObjects(cascade, frame, options);
+        }
+
+#ifdef CASCADE_STATS
+        ResetCascadeStats(); //only measured iterations are reported
+#endif
+
+        var latenciesMs = List<double>();
+        var windowCount = 0l, detectionCount = 0l;
+        var totalNs = (UInt64)0;
+
+        for (var i = 0; i < iterations; i++)
+        {
+            for (var& frame: frames)
+            {
+                var frameWindowCount = 0l;
+
+                var tic = Stopwatch::TotalNanoseconds();
+                var detections = DetectObjects(cascade, frame, frameWindowCount, options);
+                var toc = Stopwatch::TotalNanoseconds();
+
+                totalNs += (toc - tic);
+                latenciesMs.Add((double)(toc - tic) / 1e6);
+                windowCount += frameWindowCount;
+                detectionCount += detections.Count();
+            }
+        }
+
+        var frameCount = latenciesMs.Count();
+        var latencySum = 0.0;
+        for (var l: latenciesMs)
+            latencySum += l;
+
+        latenciesMs.Sort();
+
+        var result = BenchmarkResult();
+        result.ThreadCount        = threadCount;
+        result.Tier               = tier;
+        result.FrameCount         = frameCount;
+        result.WindowCount        = windowCount;
+        result.WindowsPerSecond   = (totalNs > 0) ? (double)windowCount / ((double)totalNs / 1e9) : 0;
+        result.NsPerWindow        = (windowCount > 0) ? (double)totalNs / windowCount : 0;
+        result.DetectionsPerFrame = (frameCount > 0) ? (double)detectionCount / frameCount : 0;
+        result.LatencyMeanMs      = (frameCount > 0) ? latencySum / frameCount : 0;
+        result.LatencyP50Ms       = Percentile(latenciesMs, 50);
+        result.LatencyP90Ms       = Percentile(latenciesMs, 90);
+        result.LatencyP99Ms       = Percentile(latenciesMs, 99);
+
+        return result;
+    }
+
+    /// @brief Converts a string into a JSON string literal (quoted and escaped).
+    /// @param str Source string.
+    /// @return JSON string.
+    static string JsonString(const string& str)
+    {
+        var chars = List<char>();
+        chars.Add('"');
+
+        for (var chr: (string&)str)
+        {
+            if (chr == '"' || chr == '\\')
+                chars.Add('\\');
+
+            chars.Add(chr);
+        }
+
+        chars.Add('"');
+        return chars<-ToString();
+    }
+
+    /// @brief Serializes benchmark results into JSON.
+    /// @param source Benchmark source (image folder or video).
+    /// @param cascade Benchmarked cascade.
+    /// @param frameCount Number of frames in the source.
+    /// @param warmupIterations Number of warm-up iterations.
+    /// @param iterations Number of measured iterations.
+    /// @param results Results (one for each thread count and quality tier).
+    /// @return JSON string.
+    string BenchmarkToJson(const string& source, Cascade& cascade, int frameCount, int warmupIterations, int iterations, List<BenchmarkResult>& results)
+    {
+        var json = (string)"{\n";
+        json = json + "  \"source\": " + JsonString(source) + ",\n";
+        json = json + "  \"cascadeTrees\": " + (int)cascade.Trees.Count() + ",\n";
+        json = json + "  \"cascadeStages\": " + cascade.StageCount() + ",\n";
+        json = json + "  \"compiledCascade\": " + String(cascade.IsCompiled) + ",\n";
+        json = json + "  \"frames\": " + frameCount + ",\n";
+        json = json + "  \"warmupIterations\": " + warmupIterations + ",\n";
+        json = json + "  \"iterations\": " + iterations + ",\n";
+        json = json + "  \"results\": [\n";
+
+        for (var i = 0; i < results.Count(); i++)
+        {
+            var& r = results[i];
+            json = json + "    {\n";
+            json = json + "      \"threads\": " + r.ThreadCount + ",\n";
+            json = json + "      \"tier\": " + r.Tier + ",\n";
+            json = json + "      \"frames\": " + r.FrameCount + ",\n";
+            json = json + "      \"windows\": " + r.WindowCount + ",\n";
+            json = json + "      \"windowsPerSecond\": " + String(r.WindowsPerSecond, 1) + ",\n";
+            json = json + "      \"nsPerWindow\": " + String(r.NsPerWindow, 3) + ",\n";
+            json = json + "      \"detectionsPerFrame\": " + String(r.DetectionsPerFrame, 3) + ",\n";
+            json = json + "      \"latencyMs\": { ";
+            json = json + "\"mean\": " + String(r.LatencyMeanMs, 3) + ", ";
+            json = json + "\"p50\": " + String(r.LatencyP50Ms, 3) + ", ";
+            json = json + "\"p90\": " + String(r.LatencyP90Ms, 3) + ", ";
+            json = json + "\"p99\": " + String(r.LatencyP99Ms, 3) + " }\n";
+            json = json + "    }" + ((i < results.Count() - 1) ? "," : "") + "\n";
+        }
+
+        json = json + "  ]\n";
+        json = json + "}\n";
+        return json;
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include "../Shared/Cascade.hpp"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+namespace ViolaJones
+{
+    /// @brief Cascade evaluation statistics. Collected only if CASCADE_STATS is defined (see Test.hpp).
+    ///        Counters are kept per tree (stages are resolved when reporting) and per scale.
+    struct CascadeStats
+    {
+        /// @brief Number of windows evaluated by each tree.
+        List<long> TreeWindows;
+        /// @brief Number of windows rejected by each tree.
+        List<long> TreeRejections;
+
+        /// @brief Window height of each scale.
+        List<int> ScaleSizes;
+        /// @brief Number of windows evaluated on each scale.
+        List<long> ScaleWindows;
+        /// @brief Time spent (summed over all threads) on each scale.
+        List<UInt64> ScaleNs;
+
+        /// @brief Clears all counters and prepares them for the specified tree count.
+        /// @param treeCount Cascade tree count.
+        void Reset(int treeCount)
+        {
+            TreeWindows.Clear();    TreeWindows.Add(0, treeCount);
+            TreeRejections.Clear(); TreeRejections.Add(0, treeCount);
+
+            ScaleSizes.Clear();
+            ScaleWindows.Clear();
+            ScaleNs.Clear();
+        }
+
+        /// @brief Adds counters of a single scale.
+        /// @param scaleIdx Scale index.
+        /// @param size Window height.
+        /// @param windowCount Number of evaluated windows.
+        /// @param ns Elapsed time.
+        void AddScale(int scaleIdx, int size, long windowCount, UInt64 ns)
+        {
+            while (ScaleSizes.Count() <= scaleIdx)
+            {
+                ScaleSizes.Add(0);
+                ScaleWindows.Add(0);
+                ScaleNs.Add(0);
+            }
+
+            if (size > 0)
+                ScaleSizes[scaleIdx] = size;
+
+            ScaleWindows[scaleIdx] += windowCount;
+            ScaleNs[scaleIdx] += ns;
+        }
+
+        /// @brief Adds (aggregates) counters from other statistics (e.g. from other thread).
+        /// @param other Other statistics.
+        void Add(CascadeStats& other)
+        {
+            if (TreeWindows.Count() != other.TreeWindows.Count())
+                Reset(other.TreeWindows.Count());
+
+            for (var i = 0; i < other.TreeWindows.Count(); i++)
+            {
+                TreeWindows[i] += other.TreeWindows[i];
+                TreeRejections[i] += other.TreeRejections[i];
+            }
+
+            for (var i = 0; i < other.ScaleSizes.Count(); i++)
+                AddScale(i, other.ScaleSizes[i], other.ScaleWindows[i], other.ScaleNs[i]);
+        }
+    };
+
+    /// @brief Creates a report from the collected statistics: windows entering and leaving each stage, tree evaluations and time per scale.
+    /// @param cascade Evaluated cascade.
+    /// @param stats Collected statistics.
+    /// @return Report.
+    string CascadeStatsReport(Cascade& cascade, CascadeStats& stats)
+    {
+        if (stats.TreeWindows.Count() != cascade.Trees.Count())
+            return (string)"No cascade statistics collected.\n";
+
+        var windowCount = (stats.TreeWindows.Count() > 0) ? stats.TreeWindows[0] : 0;
+        var treeEvalCount = 0l;
+        for (var n: stats.TreeWindows)
+            treeEvalCount += n;
+
+        var str = (string)"Cascade stats - windows: " + windowCount + ", trees/window: " + String((double)treeEvalCount / Math::Max(1l, windowCount), 2) + "\n";
+        str = str + "\tStage | trees | entered     | rejected    | pass rate | tree evals  | cost share\n";
+
+        var stageIdx = 0, stageStart = 0;
+        for (var treeIdx = 0; treeIdx < cascade.Trees.Count(); treeIdx++)
+        {
+            var isStageEnd = cascade.IsStageEnd(treeIdx) || treeIdx == cascade.Trees.Count() - 1;
+            if (!isStageEnd)
+                continue;
+
+            var entered = stats.TreeWindows[stageStart];
+            var rejected = 0l, treeEvals = 0l;
+            for (var i = stageStart; i <= treeIdx; i++)
+            {
+                rejected += stats.TreeRejections[i];
+                treeEvals += stats.TreeWindows[i];
+            }
+
+            var passRate = (entered > 0) ? (double)(entered - rejected) / entered : 0.0;
+            var costShare = (double)treeEvals / Math::Max(1l, treeEvalCount);
+
+            str = str + "\t" + String(stageIdx + 1).PadLeft(5) + " | " + String(treeIdx - stageStart + 1).PadLeft(5) + " | " +
+                  String(entered).PadLeft(11) + " | " + String(rejected).PadLeft(11) + " | " +
+                  String(passRate, 4).PadLeft(9) + " | " + String(treeEvals).PadLeft(11) + " | " + String(costShare * 100, 1).PadLeft(9) + "%\n";
+
+            stageIdx++;
+            stageStart = treeIdx + 1;
+        }
+
+        var totalNs = (UInt64)0;
+        for (var ns: stats.ScaleNs)
+            totalNs += ns;
+
+        str = str + "\tScale | size  | windows     | time [ms]   | time share\n";
+        for (var i = 0; i < stats.ScaleSizes.Count(); i++)
+        {
+            var timeShare = (double)stats.ScaleNs[i] / Math::Max((UInt64)1, totalNs);
+
+            str = str + "\t" + String(i + 1).PadLeft(5) + " | " + String(stats.ScaleSizes[i]).PadLeft(5) + " | " +
+                  String(stats.ScaleWindows[i]).PadLeft(11) + " | " + String((double)stats.ScaleNs[i] / 1e6, 2).PadLeft(11) + " | " +
+                  String(timeShare * 100, 1).PadLeft(9) + "%\n";
+        }
+
+        return str;
+    }
+}
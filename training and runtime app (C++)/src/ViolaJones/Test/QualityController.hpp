@@ -0,0 +1,117 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include "../Shared/Cascade.hpp"
+#include "../Shared/Config.hpp"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+namespace ViolaJones
+{
+    /// @brief Quality tier: ratio of evaluated (first) stages and a stage threshold scale (see DetectionOptions).
+    struct QualityTier
+    {
+        float StageRatio;
+        float ThresholdScale;
+    };
+
+    /// @brief Quality tiers from the full quality to the fastest one. Later stages are dropped and the remaining ones are made stricter to limit false positives.
+    const static QualityTier QUALITY_TIERS[] = { {1.0f, 1.0f}, {0.75f, 1.0f}, {0.5f, 0.95f}, {0.35f, 0.9f}, {0.25f, 0.85f} };
+    /// @brief Min number of frames between two tier switches.
+    const int QUALITY_MIN_TIER_FRAMES = 5;
+    /// @brief A better tier is selected only if the (smoothed) frame time is below this ratio of the target time.
+    const float QUALITY_UPGRADE_RATIO = 0.6f;
+
+    /// @brief Switches quality tiers (detection options) to hold a target detection time per frame, e.g. under load spikes.
+    ///        Only the detection options are changed - the cascade is not modified nor re-loaded. Rejection bounds of each tier are computed once, so a cheaper tier evaluates as fast as the full cascade per tree.
+    class QualityController
+    {
+        List<DetectionOptions> tiers;
+        float targetFrameMs;
+        int tierIdx = 0;
+        int tierFrameCount = 0;
+        double avgFrameMs = 0;
+
+    public:
+        /// @brief Creates a new controller.
+        /// @param cascade Evaluated cascade (its stage count).
+        /// @param targetFrameMs Target detection time per frame in ms. If 0, the full quality is always used.
+        /// @param options Base detection options (scanning).
+        QualityController(Cascade& cascade, float targetFrameMs, const DetectionOptions& options = DetectionOptions())
+        {
+            if (targetFrameMs < 0)
+                throw ArgumentException((string)"The target frame time must not be negative.");
+
+            this->targetFrameMs = targetFrameMs;
+
+            for (var& t: QUALITY_TIERS)
+            {
+                var tierOptions = options;
+                tierOptions.StageCount = (t.StageRatio < 1) ? Math::Max(1, (int)Math::Round(t.StageRatio * cascade.StageCount())) : 0;
+                tierOptions.ThresholdScale = t.ThresholdScale;
+
+                var treeCount = cascade.StageTreeCount(tierOptions.StageCount);
+                if (treeCount < cascade.Trees.Count() || t.ThresholdScale != 1)
+                    tierOptions.RejectBounds = cascade.GetRejectBounds(treeCount, t.ThresholdScale);
+
+                tiers.Add(tierOptions);
+            }
+        }
+
+        /// @brief Gets detection options of the current tier.
+        /// @return Detection options.
+        const DetectionOptions& Options()
+        {
+            return tiers[tierIdx];
+        }
+
+        /// @brief Gets the number of tiers.
+        /// @return Tier count.
+        int TierCount()
+        {
+            return tiers.Count();
+        }
+
+        /// @brief Gets detection options of a tier.
+        /// @param tierIdx Tier index (0 - full quality).
+        /// @return Detection options.
+        const DetectionOptions& TierOptions(int tierIdx)
+        {
+            return tiers[tierIdx];
+        }
+
+        /// @brief Gets the current tier index (0 - full quality).
+        /// @return Tier index.
+        int Tier()
+        {
+            return tierIdx;
+        }
+
+        /// @brief Updates the smoothed frame time and switches the tier if the target time is not held.
+        /// @param frameMs Detection time of the last frame in ms.
+        void Update(double frameMs)
+        {
+            if (targetFrameMs == 0)
+                return;
+
+            avgFrameMs = (tierFrameCount == 0) ? frameMs : 0.7 * avgFrameMs + 0.3 * frameMs;
+            tierFrameCount++;
+
+            if (tierFrameCount < QUALITY_MIN_TIER_FRAMES)
+                return;
+
+            if (avgFrameMs > targetFrameMs && tierIdx < tiers.Count() - 1)
+            {
+                tierIdx++;
+                tierFrameCount = 0;
+            }
+            else if (avgFrameMs < targetFrameMs * QUALITY_UPGRADE_RATIO && tierIdx > 0)
+            {
+                tierIdx--;
+                tierFrameCount = 0;
+            }
+        }
+    };
+}
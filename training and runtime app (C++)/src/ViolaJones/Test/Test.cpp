@@ -1,6 +1,10 @@
 #define PARALLEL 1 //execute test procedure in parallel where applicable
+#define COMPILED_CASCADE 1 //use the compiled cascade (CompiledCascade.hpp generated by the Compile app) if it exists and matches the loaded cascade
+//#define CASCADE_STATS 1 //collect per-stage and per-scale evaluation statistics (slower; the compiled cascade is not used)
 
 #include "Test.hpp"
+#include "Benchmark.hpp"
+#include "QualityController.hpp"
 #include <System.Diagnostics.h>
 #include <Extensions/ConsoleExtensions.h>
 #include <opencv2/core.hpp>
@@ -53,6 +57,28 @@ static void DrawDetections(List<Detection>& detections, cv::Mat& image)
     }
 }
 
+/// @brief Loads the cascade and enables its compiled evaluator if available.
+/// @return Cascade.
+static Cascade LoadCascade()
+{
+    var cascade = Cascade::FromFile(CASCADE_FILE_NAME);
+
+    if (TryUseCompiledCascade(cascade))
+        Console::WriteLine((string)"Using the compiled cascade.");
+
+    return cascade;
+}
+
+/// @brief Writes the collected cascade statistics (if enabled) and resets them.
+/// @param cascade Evaluated cascade.
+static void WriteCascadeStats(Cascade& cascade)
+{
+#ifdef CASCADE_STATS
+    Console::Write(CascadeStatsReport(cascade, GetCascadeStats()));
+    ResetCascadeStats();
+#endif
+}
+
 /// @brief Gets a camera capture API depending on a Windows / other OS.
 /// @return Camera capture API.
 static int GetCameraCaptureAPI()
@@ -72,7 +98,8 @@ static void DetectObjectsVideo(cv::VideoCapture& cap, bool flipFrame = false)
     if (cap.isOpened() == false)
         throw Exception((string)"Error opening video stream or file.");
 
-    var cascade = Cascade::FromFile(CASCADE_FILE_NAME);
+    var cascade = LoadCascade();
+    var quality = QualityController(cascade, VIDEO_TARGET_FRAME_MS);
     cv::Mat frame;
     cap >> frame;
 
@@ -85,13 +112,14 @@ static void DetectObjectsVideo(cv::VideoCapture& cap, bool flipFrame = false)
         var tic = Stopwatch::TotalMilliseconds();
         {
             var grayIm = BgrToGray(frame);
-            var detections = DetectObjects(cascade, grayIm);
+            var detections = DetectObjects(cascade, grayIm, quality.Options());
             DrawDetections(detections, frame);
         }
         var toc = Stopwatch::TotalMilliseconds();
+        quality.Update(toc - tic);
 
         var fps = 1000.0f / (toc - tic);
-        var txt = (string)"FPS: " + (int)fps;
+        var txt = (string)"FPS: " + (int)fps + ((quality.Tier() > 0) ? (string)", quality tier: " + quality.Tier() : (string)"");
         cv::putText(frame, cv::String(txt.Ptr()), cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 255), 2);
 
         cv::imshow("Frame", frame);
@@ -104,6 +132,7 @@ static void DetectObjectsVideo(cv::VideoCapture& cap, bool flipFrame = false)
 
     cap.release();
     cv::destroyAllWindows();
+    WriteCascadeStats(cascade);
 }
 
 static void DetectObjectsImage(const string& imFile)
@@ -112,19 +141,158 @@ static void DetectObjectsImage(const string& imFile)
     if (im.empty())
         throw ArgumentException("Can not open the specified image: " + imFile);
 
-    var cascade = Cascade::FromFile(CASCADE_FILE_NAME);
+    var cascade = LoadCascade();
     cv::namedWindow("Image", cv::WINDOW_AUTOSIZE);
 
     var grayIm = BgrToGray(im);
     var detections = DetectObjects(cascade, grayIm);
     
     DrawDetections(detections, im);
+    WriteCascadeStats(cascade);
     cv::imshow("Image", im);
 
     cv::waitKey();
     cv::destroyAllWindows();
 }
 
+/// @brief Checks whether the file is a supported video file.
+/// @param file File path.
+/// @return True if the file is a video file, false otherwise.
+static bool IsVideoFile(const string& file)
+{
+    return file.EndsWith(".mp4") || file.EndsWith(".webm") || file.EndsWith(".avi");
+}
+
+/// @brief Checks whether the file is a supported image file.
+/// @param file File path.
+/// @return True if the file is an image file, false otherwise.
+static bool IsImageFile(const string& file)
+{
+    return file.EndsWith(".jpg") || file.EndsWith(".jpeg") || file.EndsWith(".png") || file.EndsWith(".bmp");
+}
+
+/// @brief Reads grayscale frames from an image folder or a video file. All frames are kept in memory so no decoding is measured.
+/// @param source Image folder or video path.
+/// @return Grayscale frames.
+static List<cv::Mat> ReadBenchmarkFrames(const string& source)
+{
+    List<cv::Mat> frames;
+
+    if (Directory::Exists(source))
+    {
+        var files = Directory::GetFiles(source, "", true);
+        for (var& file: files)
+        {
+            if (!IsImageFile(file) || frames.Count() >= BENCHMARK_MAX_FRAMES)
+                continue;
+
+            var im = cv::imread(cv::String(file.Ptr(), file.Length()), cv::IMREAD_COLOR);
+            if (im.empty())
+                throw ArgumentException("Can not open the specified image: " + file);
+
+            frames.Add(BgrToGray(im));
+        }
+    }
+    else if (File::Exists(source) && IsVideoFile(source))
+    {
+        var cap = cv::VideoCapture(cv::String(source.Ptr()));
+        if (cap.isOpened() == false)
+            throw Exception((string)"Error opening video stream or file.");
+
+        cv::Mat frame;
+        cap >> frame;
+
+        while (frame.empty() == false && frames.Count() < BENCHMARK_MAX_FRAMES)
+        {
+            frames.Add(BgrToGray(frame));
+            cap >> frame;
+        }
+
+        cap.release();
+    }
+    else
+        throw NotSupportedException((string)"The benchmark source must be an image folder or a video file.");
+
+    if (frames.Count() == 0)
+        throw ArgumentException("The benchmark source does not contain any frames: " + source);
+
+    return frames;
+}
+
+/// @brief Writes a benchmark result into the console.
+/// @param r Benchmark result.
+static void WriteBenchmarkResult(BenchmarkResult& r)
+{
+    Console::WriteLine((string)"	Threads: " + String(r.ThreadCount).PadLeft(3) + 
+                       " | tier: " + r.Tier +
+                       " | windows/s: " + String(r.WindowsPerSecond, 0) + 
+                       " | ns/window: " + String(r.NsPerWindow, 2) + 
+                       " | latency p50/p99 [ms]: " + String(r.LatencyP50Ms, 2) + " / " + String(r.LatencyP99Ms, 2) +
+                       " | detections/frame: " + String(r.DetectionsPerFrame, 2));
+}
+
+/// @brief Runs a headless detection benchmark and writes its results as JSON.
+///        Args: bench <image folder or video> [thread counts = 1,<processor count>] [warm-up iterations = 1] [iterations = 5] [output = benchmark.json]
+/// @param args Console args (the first one is 'bench').
+static void RunBenchmark(List<string>& args)
+{
+    if (args.Count() < 2 || args.Count() > 6)
+        throw NotSupportedException((string)"Invalid number of benchmark arguments.");
+
+    var source = args[1];
+
+    var threadCounts = List<int>();
+    if (args.Count() > 2)
+    {
+        var tcs = args[2]<-Split({','});
+        for (var& tc: tcs)
+            threadCounts.Add(String::ParseInt32(tc));
+    }
+    else
+    {
+        threadCounts.Add(1);
+        if (Environment::ProcessorCount() > 1)
+            threadCounts.Add(Environment::ProcessorCount());
+    }
+
+    var warmupIterations = (args.Count() > 3) ? String::ParseInt32(args[3]) : 1;
+    var iterations       = (args.Count() > 4) ? String::ParseInt32(args[4]) : 5;
+    var outFile          = (args.Count() > 5) ? args[5] : (string)"benchmark.json";
+
+    if (warmupIterations < 0 || iterations < 1)
+        throw ArgumentException((string)"Invalid number of benchmark iterations.");
+
+    var cascade = LoadCascade();
+    var frames = ReadBenchmarkFrames(source);
+    Console::WriteLine((string)"Benchmark source: " + source + " (frames: " + (int)frames.Count() + ")");
+
+    var results = List<BenchmarkResult>();
+    for (var threadCount: threadCounts)
+    {
+        var r = BenchmarkDetection(cascade, frames, threadCount, warmupIterations, iterations);
+        results.Add(r);
+        WriteCascadeStats(cascade);
+        WriteBenchmarkResult(r);
+    }
+
+    //reduced quality tiers (see QualityController) - measured with the last thread count
+    var quality = QualityController(cascade, 0);
+    for (var tierIdx = 1; tierIdx < quality.TierCount(); tierIdx++)
+    {
+        var r = BenchmarkDetection(cascade, frames, threadCounts[threadCounts.Count() - 1], warmupIterations, iterations, quality.TierOptions(tierIdx), tierIdx);
+        results.Add(r);
+        WriteCascadeStats(cascade);
+        WriteBenchmarkResult(r);
+    }
+
+    var json = BenchmarkToJson(source, cascade, frames.Count(), warmupIterations, iterations, results);
+    var fs = FileStream(outFile, FileMode::WriteOnly);
+    fs.Write((byte*)json.Ptr(), json.Length());
+    fs.Close();
+
+    Console::WriteLine((string)"Results written to: " + outFile);
+}
+
 /// @brief Runs the app - parses the arguments and runs a detection procedure.
 /// @param args Console args.
 static void RunApp(List<string>& args)
@@ -139,6 +307,12 @@ static void RunApp(List<string>& args)
         return;
     }
 
+    if (args[0] == "bench")
+    {
+        RunBenchmark(args);
+        return;
+    }
+
     if (args.Count() > 1)
     {
         throw NotSupportedException((string)"Invalid number of arguments.");
@@ -154,8 +328,7 @@ static void RunApp(List<string>& args)
         return;
     }
 
-    if (File::Exists(imSource) && 
-        (imSource.EndsWith(".mp4") || imSource.EndsWith(".webm") || imSource.EndsWith(".avi")))
+    if (File::Exists(imSource) && IsVideoFile(imSource))
     {
         Console::WriteLine((string)"Capture from video: " + imSource);
         var cap = cv::VideoCapture(cv::String(imSource.Ptr()));
@@ -163,8 +336,7 @@ static void RunApp(List<string>& args)
         return;
     }
 
-    if (File::Exists(imSource) && 
-        (imSource.EndsWith(".jpg") || imSource.EndsWith(".jpeg") || imSource.EndsWith(".png") || imSource.EndsWith(".bmp")))
+    if (File::Exists(imSource) && IsImageFile(imSource))
     {
         Console::WriteLine((string)"Image file source: " + imSource);
         DetectObjectsImage(imSource);
@@ -184,6 +356,8 @@ int main(int argCount, char* argValues[])
     Console::WriteLine((string)"\tExample camera: 'Test 0'");
     Console::WriteLine((string)"\tExample video:  'Test video.mp4'");
     Console::WriteLine((string)"\tExample image:  'Test image.jpg'");
+    Console::WriteLine((string)"Benchmark (no GUI, JSON output): 'Test bench <image folder or video> [thread counts] [warm-up iterations] [iterations] [output file]'");
+    Console::WriteLine((string)"\tExample: 'Test bench images/ 1,2,4,8 1 5 benchmark.json'");
     Console::WriteLine();
 
     Console::ForegroundColor = ConsoleColor::Default;
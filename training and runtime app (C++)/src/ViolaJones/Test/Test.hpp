@@ -4,8 +4,17 @@
 #include <System.Threading.h>
 #include "../Shared/Cascade.hpp"
 #include "../Shared/Config.hpp"
+#include "CascadeStats.hpp"
+#include <System.Diagnostics.h>
+
+//a cascade compiled by the Compile app is used only if enabled and if the generated source exists
+#if defined(COMPILED_CASCADE) && __has_include("CompiledCascade.hpp") && !defined(CASCADE_STATS)
+#define COMPILED_CASCADE_AVAILABLE 1
+#include "CompiledCascade.hpp"
+#endif
 
 using namespace System::Threading;
+using namespace System::Diagnostics;
 
 namespace ViolaJones
 {
@@ -60,154 +69,717 @@ namespace ViolaJones
         return confidence;
     }
 
-    /// @brief Classifies a single patch (positive vs negative).
+#ifdef CASCADE_STATS
+    /// @brief Statistics collected by the calling thread (merged into cascadeStats when a detection job finishes).
+    inline static thread_local CascadeStats threadStats;
+    /// @brief Statistics aggregated over all threads and DetectObjects calls.
+    inline static CascadeStats cascadeStats;
+    inline static Mutex cascadeStatsLock;
+
+    /// @brief Merges statistics of the calling thread into the aggregated statistics.
+    static void MergeThreadStats()
+    {
+        cascadeStatsLock.Lock();
+        cascadeStats.Add(threadStats);
+        cascadeStatsLock.Unlock();
+    }
+
+    /// @brief Gets the statistics aggregated since the last reset.
+    /// @return Cascade statistics.
+    CascadeStats& GetCascadeStats()
+    {
+        return cascadeStats;
+    }
+
+    /// @brief Clears the aggregated statistics.
+    void ResetCascadeStats()
+    {
+        cascadeStats = CascadeStats();
+    }
+#endif
+
+    /// @brief Classifies a single patch (positive vs negative) by evaluating the cascade tree data.
+    ///        Rejection bounds (see Cascade::UpdateRejectBounds) are used if valid, stage thresholds otherwise - the decisions are the same.
     /// @param cascade Cascade to evaluate.
     /// @param patch Image grayscale patch.
     /// @param confidence Is set to a confidence of a patch being positive.
     /// @return True if a patch containg an object (is positive), false otherwise.
-    bool ClassifyPatch(Cascade& cascade, cv::Mat& patch, float& confidence)
+    bool EvalCascade(Cascade& cascade, cv::Mat& patch, float& confidence)
     {
         confidence = 0.0f;
+        var treeCount = (int)cascade.Trees.Count();
+        var useBounds = cascade.RejectBounds.Count() == treeCount;
 
-        for (var& tree: cascade.Trees)
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
         {
+            var& tree = cascade.Trees[treeIdx];
+#ifdef CASCADE_STATS
+            threadStats.TreeWindows[treeIdx]++;
+#endif
+
             var treeConf = EvalTree(tree, patch);
             confidence += treeConf;
 
-            if (confidence < tree.Threshold)
+            var bound = useBounds ? cascade.RejectBounds[treeIdx] : tree.Threshold;
+            if (confidence < bound)
+            {
+#ifdef CASCADE_STATS
+                threadStats.TreeRejections[treeIdx]++;
+#endif
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /// @brief Part of a cascade evaluated by a detection call (quality tier, see DetectionOptions).
+    struct CascadeTier
+    {
+        /// @brief Number of evaluated (first) trees - the last one ends a stage.
+        int TreeCount;
+        /// @brief Stage threshold scale.
+        float ThresholdScale;
+        /// @brief True if all trees are evaluated with unmodified thresholds.
+        bool IsFull;
+        /// @brief Rejection bounds of the evaluated trees (points to the detection options).
+        const float* RejectBounds;
+    };
+
+    /// @brief Gets the evaluated part of a cascade for the provided detection options.
+    /// @param cascade Cascade to evaluate.
+    /// @param options Detection options (stage count and threshold scale).
+    /// @return Cascade tier.
+    static CascadeTier GetCascadeTier(Cascade& cascade, const DetectionOptions& options)
+    {
+        var tier = CascadeTier();
+        tier.TreeCount = cascade.StageTreeCount(options.StageCount);
+        tier.ThresholdScale = options.ThresholdScale;
+        tier.IsFull = tier.TreeCount == cascade.Trees.Count() && options.ThresholdScale == 1;
+        var& bounds = options.RejectBounds;
+        tier.RejectBounds = (bounds.Count() == tier.TreeCount) ? bounds.begin() : null;
+        return tier;
+    }
+
+    /// @brief Classifies a single patch (positive vs negative) by evaluating the first trees of the cascade with the rejection bounds of the tier (scaled thresholds if the bounds are not set).
+    ///        If the cascade is compiled, its tier evaluator (or the compiled trees, if the evaluator is not generated) is used.
+    ///        The tier evaluator does not count windows - with CASCADE_STATS the compiled cascade is not included (see above) and every tier is evaluated by the counting loop.
+    /// @param cascade Cascade to evaluate.
+    /// @param patch Image grayscale patch.
+    /// @param confidence Is set to a confidence of a patch being positive.
+    /// @param tier Evaluated part of the cascade.
+    /// @return True if a patch containg an object (is positive), false otherwise.
+    bool EvalCascade(Cascade& cascade, cv::Mat& patch, float& confidence, CascadeTier& tier)
+    {
+#if defined(COMPILED_CASCADE_TIERS) && !defined(CASCADE_STATS)
+        if (cascade.IsCompiled && tier.RejectBounds != null)
+            return CompiledCascade::ClassifyPatch(patch, confidence, tier.TreeCount, tier.RejectBounds);
+#endif
+
+        confidence = 0.0f;
+        for (var treeIdx = 0; treeIdx < tier.TreeCount; treeIdx++)
+        {
+            var& tree = cascade.Trees[treeIdx];
+#ifdef CASCADE_STATS
+            threadStats.TreeWindows[treeIdx]++;
+#endif
+
+#ifdef COMPILED_CASCADE_AVAILABLE
+            confidence += cascade.IsCompiled ? CompiledCascade::TREES[treeIdx](patch.data, (int)patch.step, patch.cols, patch.rows) : EvalTree(tree, patch);
+#else
+            confidence += EvalTree(tree, patch);
+#endif
+
+            var bound = (tier.RejectBounds != null) ? tier.RejectBounds[treeIdx] :
+                        (tree.Threshold > -999) ? ScaleThreshold(tree.Threshold, tier.ThresholdScale) : tree.Threshold;
+
+            if (confidence < bound)
+            {
+#ifdef CASCADE_STATS
+                threadStats.TreeRejections[treeIdx]++;
+#endif
                 return false;
+            }
         }
 
         return true;
     }
 
+    /// @brief Classifies a single patch (positive vs negative). The compiled evaluator is used if enabled for the cascade.
+    /// @param cascade Cascade to evaluate.
+    /// @param patch Image grayscale patch.
+    /// @param confidence Is set to a confidence of a patch being positive.
+    /// @return True if a patch containg an object (is positive), false otherwise.
+    bool ClassifyPatch(Cascade& cascade, cv::Mat& patch, float& confidence)
+    {
+#ifdef COMPILED_CASCADE_AVAILABLE
+        if (cascade.IsCompiled)
+            return CompiledCascade::ClassifyPatch(patch, confidence);
+#endif
+
+        return EvalCascade(cascade, patch, confidence);
+    }
 
+    /// @brief Classifies a single patch (positive vs negative) using a part of the cascade. 
+    ///        The full cascade is evaluated by ClassifyPatch, a partial tier tree by tree with its own rejection bounds.
+    /// @param cascade Cascade to evaluate.
+    /// @param patch Image grayscale patch.
+    /// @param confidence Is set to a confidence of a patch being positive.
+    /// @param tier Evaluated part of the cascade.
+    /// @return True if a patch containg an object (is positive), false otherwise.
+    bool ClassifyPatch(Cascade& cascade, cv::Mat& patch, float& confidence, CascadeTier& tier)
+    {
+        if (tier.IsFull)
+            return ClassifyPatch(cascade, patch, confidence);
 
-    using DetectionArgs = Tuple<Cascade&, cv::Mat&, Range<int>, List<Detection>&, Mutex&>; 
+        return EvalCascade(cascade, patch, confidence, tier);
+    }
+
+    using ClassifyPatchesArgs = Tuple<Cascade&, List<cv::Mat>&, List<float>&, List<bool>&>;
+
+    /// @brief Classifies a set of patches (in parallel if enabled). Each patch is classified by ClassifyPatch (the compiled evaluator if enabled) and writes only its own results, so no locking is needed.
+    /// @param cascade Cascade to evaluate.
+    /// @param patches Image grayscale patches.
+    /// @param confidences Is set to patch confidences (in the patch order).
+    /// @return True for patches containing an object (positive), false otherwise.
+    List<bool> ClassifyPatches(Cascade& cascade, List<cv::Mat>& patches, List<float>& confidences)
+    {
+        var results = List<bool>();
+        results.Add(false, patches.Count());
+        confidences.Clear();
+        confidences.Add(0.0f, patches.Count());
+
+#ifndef PARALLEL
+        for (var i = 0; i < patches.Count(); i++)
+            results[i] = ClassifyPatch(cascade, patches[i], confidences[i]);
+#else
+        var args = ClassifyPatchesArgs(cascade, patches, confidences, results);
+        Parallel<ClassifyPatchesArgs>::For(0, patches.Count(), [](ClassifyPatchesArgs args, long i, bool& shouldCancel)
+        {
+            var& [cascade, patches, confidences, results] = args;
+            results[i] = ClassifyPatch(cascade, patches[i], confidences[i]);
+        },
+        args);
+#endif
+
+        return results;
+    }
+
+#ifdef COMPILED_CASCADE_AVAILABLE
+    /// @brief Checks that the compiled cascade produces the same outputs as the interpreted one.
+    ///        Every tree and the whole cascade are evaluated on random windows of a random noise image.
+    /// @param cascade Cascade the compiled version is generated from.
+    /// @param windowCount Number of random windows to check.
+    /// @return True if all the outputs are equal, false otherwise.
+    static bool VerifyCompiledCascade(Cascade& cascade, int windowCount = 2000)
+    {
+        if (CompiledCascade::TREE_COUNT != cascade.Trees.Count())
+            return false;
+
+        var rand = Random(0);
+        var image = cv::Mat(256, 256, CV_8UC1, cv::Scalar(0));
+        for (var r = 0; r < image.rows; r++)
+            for (var c = 0; c < image.cols; c++)
+                image.at<byte>(r, c) = (byte)rand.Next(0, 256);
+
+        for (var i = 0; i < windowCount; i++)
+        {
+            var h = rand.Next(2, image.rows);
+            var w = Math::Max(1, Math::Min((int)(h * cascade.WidthHeightRatio), image.cols));
+            var patch = cv::Mat(image, cv::Rect(rand.Next(0, image.cols - w), rand.Next(0, image.rows - h), w, h));
+
+            for (var treeIdx = 0; treeIdx < CompiledCascade::TREE_COUNT; treeIdx++)
+            {
+                var expected = EvalTree(cascade.Trees[treeIdx], patch);
+                var actual = CompiledCascade::TREES[treeIdx](patch.data, (int)patch.step, patch.cols, patch.rows);
+                if (expected != actual)
+                    return false;
+            }
+
+            var expectedConf = 0.0f, actualConf = 0.0f;
+            var expected = EvalCascade(cascade, patch, expectedConf);
+            var actual = CompiledCascade::ClassifyPatch(patch, actualConf);
+            if (expected != actual || expectedConf != actualConf)
+                return false;
+        }
+
+        return true;
+    }
+#endif
+
+    /// @brief Enables the compiled evaluator for the cascade if it is compiled in, generated from the same cascade and equivalent to the interpreted one.
+    /// @param cascade Loaded cascade.
+    /// @return True if the compiled evaluator is used, false otherwise.
+    static bool TryUseCompiledCascade(Cascade& cascade)
+    {
+        cascade.IsCompiled = false;
+
+#ifdef COMPILED_CASCADE_AVAILABLE
+        if (CompiledCascade::CHECKSUM != cascade.Checksum())
+        {
+            Console::Warning((string)"The compiled cascade does not match the loaded cascade. Re-generate it using the Compile app.");
+            return false;
+        }
+
+        if (VerifyCompiledCascade(cascade) == false)
+        {
+            Console::Error((string)"The compiled cascade outputs differ from the interpreted cascade outputs. The compiled cascade is not used.");
+            return false;
+        }
+
+        cascade.IsCompiled = true;
+#endif
+
+        return cascade.IsCompiled;
+    }
+
+    /// @brief Detection output shared by detection threads.
+    struct DetectionResult
+    {
+        /// @brief Detections of each job (in the job order). Each job writes only its own list, so the output does not depend on the thread scheduling.
+        List<List<Detection>> JobDetections;
+        /// @brief Number of evaluated windows (patches).
+        long WindowCount = 0;
+        /// @brief Max number of detections (0 - not limited). A job stops scanning when it reaches the limit itself.
+        int MaxDetections = 0;
+        Mutex Lock;
+
+        /// @brief Concatenates detections of all jobs in the job (scale) order and keeps the first MaxDetections ones.
+        /// @return Collection of found objects.
+        List<Detection> Detections()
+        {
+            var detections = List<Detection>();
+            for (var& jobDetections: JobDetections)
+            {
+                for (var& d: jobDetections)
+                {
+                    if (MaxDetections > 0 && detections.Count() >= MaxDetections)
+                        return detections;
+
+                    detections.Add(d);
+                }
+            }
+
+            return detections;
+        }
+    };
+
+    /// @brief Area where objects are searched: a window is evaluated only if its center lies in one of the regions and in the mask (if set).
+    struct DetectionArea
+    {
+        /// @brief Regions (pixel coordinates) of allowed window centers.
+        List<cv::Rect> Regions;
+        /// @brief Optional binary mask (CV_8UC1, image size) of allowed window centers. Non-zero values are allowed.
+        cv::Mat Mask;
+    };
+
+    /// @brief Windows scanned by a single detection job: a single scale, a single region and a range of window rows.
+    struct ScanJob
+    {
+        /// @brief Job index (position in the job list).
+        int Index;
+        int ScaleIdx;
+        /// @brief Window height.
+        float Scale;
+        /// @brief Window offset step in pixels.
+        int Step;
+        int RegionIdx;
+        /// @brief Window top rows (inclusive).
+        Range<int> Rows;
+        /// @brief Evaluated part of the cascade.
+        CascadeTier Tier;
+    };
+
+    /// @brief Min number of windows in a single detection job (a job is a unit of parallel work).
+    const int MIN_JOB_WINDOW_COUNT = 1024;
+
+    using DetectionArgs = Tuple<Cascade&, cv::Mat&, DetectionArea&, ScanJob, DetectionResult&>;
     inline static ThreadPool<DetectionArgs> threadPool;
-   
-    /// @brief Detects objects on an image vertical slice. Used in parallel object detection.
-    /// @param args Function arguments passed in a thread. 
-    static void DetectObjectsSlice(DetectionArgs args)
+
+    /// @brief Gets scales (window heights) to scan for the provided image size.
+    /// @param imSize Image size.
+    /// @param options Detection options (size range and scale factor).
+    /// @return Scales.
+    static List<float> GetScales(cv::Size imSize, const DetectionOptions& options)
     {
-        var& [cascade, image, rowRange, detections, lockObj] = args;
-        var w = image.cols;
-        var h = image.rows;
+        var scales = List<float>();
+        var minSide = Math::Min(imSize.width, imSize.height);
+
+        var maxSize = (options.MaxSize > 0) ? Math::Min(options.MaxSize, minSide) : minSide;
+        var s = (options.MinSize > 0) ? (float)options.MinSize : options.MinRelativeSize * minSide;
 
-        var s = MIN_SCALE_FACTOR * Math::Min(w, h);
-        while (s < Math::Min(w, h))
+        while (s < minSide && s <= maxSize)
         {
-            var step = (int)Math::Max((float)Math::Floor(STEP_SCALE * s), 1.0f);
+            scales.Add(s);
+            s = Math::Max((float)Math::Floor(s * options.ScaleFactor), s + 1); //the scale must increase even for small windows
+        }
+
+        return scales;
+    }
+
+    /// @brief Gets the window offset step for the provided scale.
+    /// @param s Scale (window height).
+    /// @param stepFraction Step fraction (multiplies the scale).
+    /// @return Step in pixels.
+    static int GetScanStep(float s, float stepFraction)
+    {
+        return (int)Math::Max((float)Math::Floor(stepFraction * s), 1.0f);
+    }
+
+    /// @brief Gets a range of window grid positions (top row or left column) whose centers lie in the specified interval.
+    /// @param regionStart Interval start (inclusive).
+    /// @param regionLength Interval length.
+    /// @param windowSize Window size.
+    /// @param maxPosition Window position limit (exclusive).
+    /// @param step Grid step.
+    /// @return Range of positions (inclusive); empty if Start > Stop.
+    static Range<int> GetGridRange(int regionStart, int regionLength, float windowSize, float maxPosition, int step)
+    {
+        var half = (int)windowSize / 2;
+
+        var start = Math::Max(0, regionStart - half);
+        start = ((start + step - 1) / step) * step; //align to the grid
+
+        var stop = start - step;
+        for (var p = start; p < maxPosition && (p + half) < (regionStart + regionLength); p += step)
+            stop = p;
+
+        return Range<int>(start, stop);
+    }
+
+    /// @brief Checks whether a window center is allowed: it lies in the mask (if set) and it is not contained in any previous region (evaluated by another job).
+    /// @param area Detection area.
+    /// @param regionIdx Region index of the current job.
+    /// @param row Window center row.
+    /// @param col Window center column.
+    /// @return True if the window should be evaluated, false otherwise.
+    static bool IsCenterAllowed(DetectionArea& area, int regionIdx, int row, int col)
+    {
+        if (area.Mask.empty() == false && area.Mask.at<byte>(row, col) == 0)
+            return false;
+
+        for (var i = 0; i < regionIdx; i++)
+        {
+            var& region = area.Regions[i];
+            if (col >= region.x && col < (region.x + region.width) && row >= region.y && row < (region.y + region.height))
+                return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Creates detection jobs: each scale and each region is split into row ranges containing at least MIN_JOB_WINDOW_COUNT windows.
+    /// @param imSize Image size.
+    /// @param cascade Cascade to evaluate.
+    /// @param area Detection area.
+    /// @param options Detection options.
+    /// @return Detection jobs.
+    static List<ScanJob> CreateScanJobs(cv::Size imSize, Cascade& cascade, DetectionArea& area, const DetectionOptions& options)
+    {
+        var jobs = List<ScanJob>();
+        var scales = GetScales(imSize, options);
+        var tier = GetCascadeTier(cascade, options);
+
+        for (var scaleIdx = 0; scaleIdx < scales.Count(); scaleIdx++)
+        {
+            var s = scales[scaleIdx];
+            var step = GetScanStep(s, options.StepFraction);
             var ww = Math::Floor(s * cascade.WidthHeightRatio);
 
-            for (var r = rowRange.Start; r < Math::Min(rowRange.Stop + 1, (int)(h - s)); r += step)
+            for (var regionIdx = 0; regionIdx < area.Regions.Count(); regionIdx++)
             {
-                for (var c = 0; c < (w - ww); c += step)
+                var& region = area.Regions[regionIdx];
+                var rows = GetGridRange(region.y, region.height, s, imSize.height - s, step);
+                var cols = GetGridRange(region.x, region.width, ww, imSize.width - ww, step);
+                if (rows.Start > rows.Stop || cols.Start > cols.Stop)
+                    continue;
+
+                var colCount = (cols.Stop - cols.Start) / step + 1;
+                var rowsPerJob = Math::Max(1, MIN_JOB_WINDOW_COUNT / colCount);
+
+                for (var r = rows.Start; r <= rows.Stop; r += rowsPerJob * step)
                 {
-                    var rect = cv::Rect(c, r, ww, s);
-                    var patch = cv::Mat(image, rect);
-
-                    var conf = 0.0f;
-                    var result = ClassifyPatch(cascade, patch, conf);
-                    if (result)
-                    {
-                        Detection d = { .Row = r, .Col = c, .Scale = s, .Confidence = conf };
-
-                        lockObj.Lock();
-                        detections.Add(d);
-                        lockObj.Unlock();
-                    }
+                    var lastRow = Math::Min(rows.Stop, r + (rowsPerJob - 1) * step);
+                    jobs.Add(ScanJob { .Index = (int)jobs.Count(), .ScaleIdx = scaleIdx, .Scale = s, .Step = step, .RegionIdx = regionIdx, .Rows = Range<int>(r, lastRow), .Tier = tier });
                 }
             }
+        }
+
+        return jobs;
+    }
 
-            s = Math::Floor(s * SCALE_INCREASE);
+    /// @brief Evaluates windows of a single detection job. Used in both sequential and parallel object detection.
+    /// @param args Function arguments passed in a thread. 
+    static void DetectObjectsJob(DetectionArgs args)
+    {
+        var& [cascade, image, area, job, result] = args;
+        var w = image.cols;
+        var s = job.Scale;
+        var windowCount = 0l;
+
+#ifdef CASCADE_STATS
+        threadStats.Reset(cascade.Trees.Count());
+        var scaleTic = Stopwatch::TotalNanoseconds();
+#endif
+
+        var step = job.Step;
+        var ww = Math::Floor(s * cascade.WidthHeightRatio);
+        var& region = area.Regions[job.RegionIdx];
+        var cols = GetGridRange(region.x, region.width, ww, w - ww, step);
+        var isFullScan = area.Mask.empty() && job.RegionIdx == 0;
+        var& detections = result.JobDetections[job.Index];
+        var isFull = false;
+
+        for (var r = job.Rows.Start; r <= job.Rows.Stop && !isFull; r += step)
+        {
+            for (var c = cols.Start; c <= cols.Stop; c += step)
+            {
+                if (!isFullScan && !IsCenterAllowed(area, job.RegionIdx, r + (int)s / 2, c + (int)ww / 2))
+                    continue;
+
+                var rect = cv::Rect(c, r, ww, s);
+                var patch = cv::Mat(image, rect);
+
+                var conf = 0.0f;
+                var isPositive = ClassifyPatch(cascade, patch, conf, job.Tier);
+                windowCount++;
+
+                if (isPositive)
+                {
+                    Detection d = { .Row = r, .Col = c, .Scale = s, .Confidence = conf };
+                    detections.Add(d);
+
+                    isFull = result.MaxDetections > 0 && detections.Count() >= result.MaxDetections;
+                    if (isFull)
+                        break;
+                }
+            }
         }
+
+        result.Lock.Lock();
+        result.WindowCount += windowCount;
+        result.Lock.Unlock();
+
+#ifdef CASCADE_STATS
+        threadStats.AddScale(job.ScaleIdx, s, windowCount, Stopwatch::TotalNanoseconds() - scaleTic);
+        MergeThreadStats();
+#endif
     }
 
     /// @brief Detects objects on an image in parallel (using a thread pool).
     /// @param cascade Cascade to evaluate.
     /// @param image Image to scan.
+    /// @param area Detection area.
+    /// @param options Detection options.
+    /// @param windowCount Is set to the number of evaluated windows.
     /// @return Collection of found objects.
-    static List<Detection> DetectObjectsParallel(Cascade& cascade, cv::Mat& image)
+    static List<Detection> DetectObjectsParallel(Cascade& cascade, cv::Mat& image, DetectionArea& area, const DetectionOptions& options, long& windowCount)
     {
         //start the thread pool, if not started already.
         if (threadPool.ThreadCount() == 0)
             threadPool.Start();
 
-        List<Detection> detections;
-        Mutex lockObj;
-
-        var w = image.cols;
-        var h = image.rows;
-        var maxSliceHeight = (int)Math::Max(1, h / threadPool.ThreadCount());
+        DetectionResult result;
+        result.MaxDetections = options.MaxDetections;
 
-        //break the image into slices which are then queued by the thread pool.
-        var row = 0;
-        while (row < h)
+        //each job covers a part of a single scale (and region) - they are queued by the thread pool.
+        var jobs = CreateScanJobs(image.size(), cascade, area, options);
+        result.JobDetections.Add(List<Detection>(), jobs.Count());
+        for (var& job: jobs)
         {
-            var sliceBottom = (int)Math::Min(row + maxSliceHeight - 1, h - 1);
-            var rowSlice = Range<int>(row, sliceBottom);
-
-            var args = DetectionArgs(cascade, image, rowSlice, detections, lockObj);
-            threadPool.QueueJob(DetectObjectsSlice, args);
-
-            row += maxSliceHeight / 2;
+            var args = DetectionArgs(cascade, image, area, job, result);
+            threadPool.QueueJob(DetectObjectsJob, args);
         }
 
         //wait all thread to finish execution (they are reused afterwards).
         threadPool.WaitAll();
-        return detections;
+
+        windowCount = result.WindowCount;
+        return result.Detections();
     }
 
     /// @brief Detects objects on an image on a single thread.
     /// @param cascade Cascade to evaluate.
     /// @param image Image to scan.
+    /// @param area Detection area.
+    /// @param options Detection options.
+    /// @param windowCount Is set to the number of evaluated windows.
     /// @return Collection of found objects.
-    static List<Detection> DetectObjectsSequential(Cascade& cascade, cv::Mat& image)
+    static List<Detection> DetectObjectsSequential(Cascade& cascade, cv::Mat& image, DetectionArea& area, const DetectionOptions& options, long& windowCount)
     {
-        List<Detection> detections;
-        var w = image.cols;
-        var h = image.rows;
-        var s = MIN_SCALE_FACTOR * Math::Min(w, h);
+        DetectionResult result;
+        result.MaxDetections = options.MaxDetections;
 
-        while (s < Math::Min(w, h))
-        {
-            var step = (int)Math::Max((float)Math::Floor(STEP_SCALE * s), 1.0f);
-            var ww = Math::Floor(s * cascade.WidthHeightRatio);
+        var jobs = CreateScanJobs(image.size(), cascade, area, options);
+        result.JobDetections.Add(List<Detection>(), jobs.Count());
 
-            for (var r = 0; r < h - s; r += step)
-            {
-                for (var c = 0; c < (w - ww); c += step)
-                {
-                    var rect = cv::Rect(c, r, ww, s);
-                    var patch = cv::Mat(image, rect);
-
-                    var conf = 0.0f;
-                    var result = ClassifyPatch(cascade, patch, conf);
-                    if (result)
-                    {
-                        Detection d = { .Row = r, .Col = c, .Scale = s, .Confidence = conf };
-                        detections.Add(d);
-                    }
-                }
-            }
+        for (var i = 0; i < jobs.Count(); i++)
+            DetectObjectsJob(DetectionArgs(cascade, image, area, jobs[i], result));
+
+        windowCount = result.WindowCount;
+        return result.Detections();
+    }
+
+    /// @brief Validates the detection options.
+    /// @param options Detection options.
+    static void ValidateDetectionOptions(const DetectionOptions& options)
+    {
+        if (options.MinSize < 0 || options.MaxSize < 0 || (options.MaxSize > 0 && options.MinSize > options.MaxSize))
+            throw ArgumentException((string)"Invalid detection object size range.");
+
+        if (options.MinSize == 0 && (options.MinRelativeSize <= 0 || options.MinRelativeSize > 1))
+            throw ArgumentException((string)"The relative min object size must be in range (0..1].");
+
+        if (options.StepFraction <= 0 || options.ScaleFactor <= 1 || options.MaxDetections < 0)
+            throw ArgumentException((string)"The step fraction must be positive, the scale factor must be larger than 1 and the max detection count must not be negative.");
+
+        if (options.StageCount < 0 || options.ThresholdScale <= 0)
+            throw ArgumentException((string)"The stage count must not be negative and the threshold scale must be positive.");
+    }
+
+    /// @brief Validates the detection area and clips its regions to the image. 
+    /// @param image Image to scan.
+    /// @param area Detection area.
+    static void PrepareDetectionArea(cv::Mat& image, DetectionArea& area)
+    {
+        if (area.Mask.empty() == false && 
+            (area.Mask.rows != image.rows || area.Mask.cols != image.cols || area.Mask.type() != CV_8UC1))
+            throw ArgumentException((string)"The detection mask must be a single channel byte image of the same size as the image.");
 
-            s = Math::Floor(s * SCALE_INCREASE);
+        var imRect = cv::Rect(0, 0, image.cols, image.rows);
+        var regions = List<cv::Rect>();
+
+        for (var& region: area.Regions)
+        {
+            var clipped = region & imRect;
+            if (clipped.area() > 0)
+                regions.Add(clipped);
         }
-        
-        return detections;
+
+        area.Regions = regions;
     }
 
-    /// @brief Detects objects on an image.
+    /// @brief Detects objects on an image within the specified area.
     /// @param cascade Cascade to evaluate.
     /// @param image Image to scan.
+    /// @param area Detection area (regions are clipped to the image).
+    /// @param options Detection options.
+    /// @param windowCount Is set to the number of evaluated windows.
     /// @return Collection of found objects.
-    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image)
+    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image, DetectionArea& area, const DetectionOptions& options, long& windowCount)
     {
+        ValidateDetectionOptions(options);
+
+        //a partial tier without precomputed rejection bounds gets them for this call
+        var tier = GetCascadeTier(cascade, options);
+        if (!tier.IsFull && tier.RejectBounds == null)
+        {
+            var tierOptions = options;
+            tierOptions.RejectBounds = cascade.GetRejectBounds(tier.TreeCount, options.ThresholdScale);
+            return DetectObjects(cascade, image, area, tierOptions, windowCount);
+        }
+
+        PrepareDetectionArea(image, area);
+
 #ifndef PARALLEL
-        return DetectObjectsSequential(cascade, image);
+        return DetectObjectsSequential(cascade, image, area, options, windowCount);
 #else
-         return DetectObjectsParallel(cascade, image);
+        return DetectObjectsParallel(cascade, image, area, options, windowCount);
 #endif
     }
+
+    /// @brief Detects objects on an image.
+    /// @param cascade Cascade to evaluate.
+    /// @param image Image to scan.
+    /// @param windowCount Is set to the number of evaluated windows.
+    /// @param options Detection options.
+    /// @return Collection of found objects.
+    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image, long& windowCount, const DetectionOptions& options = DetectionOptions())
+    {
+        var area = DetectionArea();
+        area.Regions.Add(cv::Rect(0, 0, image.cols, image.rows));
+
+        return DetectObjects(cascade, image, area, options, windowCount);
+    }
+
+    /// @brief Detects objects on an image.
+    /// @param cascade Cascade to evaluate.
+    /// @param image Image to scan.
+    /// @param options Detection options.
+    /// @return Collection of found objects.
+    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image, const DetectionOptions& options = DetectionOptions())
+    {
+        var windowCount = 0l;
+        return DetectObjects(cascade, image, windowCount, options);
+    }
+
+    /// @brief Detects objects on an image, but only in the specified regions (e.g. a conveyor area or a doorway).
+    ///        Only windows whose centers lie in the regions are evaluated.
+    /// @param cascade Cascade to evaluate.
+    /// @param image Image to scan.
+    /// @param regions Regions (pixel coordinates) of allowed window centers.
+    /// @param options Detection options.
+    /// @return Collection of found objects.
+    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image, List<cv::Rect>& regions, const DetectionOptions& options = DetectionOptions())
+    {
+        var area = DetectionArea();
+        area.Regions = regions;
+
+        var windowCount = 0l;
+        return DetectObjects(cascade, image, area, options, windowCount);
+    }
+
+    /// @brief Gets the bounding box of non-zero mask pixels.
+    /// @param mask Binary mask (CV_8UC1).
+    /// @return Bounding box; empty if the mask has no non-zero pixels.
+    static cv::Rect GetMaskBounds(cv::Mat& mask)
+    {
+        var minRow = mask.rows, maxRow = -1;
+        var minCol = mask.cols, maxCol = -1;
+
+        for (var r = 0; r < mask.rows; r++)
+        {
+            var row = mask.ptr<byte>(r);
+            for (var c = 0; c < mask.cols; c++)
+            {
+                if (row[c] == 0)
+                    continue;
+
+                minRow = Math::Min(minRow, r); maxRow = Math::Max(maxRow, r);
+                minCol = Math::Min(minCol, c); maxCol = Math::Max(maxCol, c);
+            }
+        }
+
+        if (maxRow < 0)
+            return cv::Rect();
+
+        return cv::Rect(minCol, minRow, maxCol - minCol + 1, maxRow - minRow + 1);
+    }
+
+    /// @brief Detects objects on an image, but only where the mask is set (e.g. areas flagged by a motion detector).
+    ///        Only windows whose centers lie on non-zero mask pixels are evaluated.
+    /// @param cascade Cascade to evaluate.
+    /// @param image Image to scan.
+    /// @param mask Binary mask (CV_8UC1, image size).
+    /// @param options Detection options.
+    /// @return Collection of found objects.
+    List<Detection> DetectObjects(Cascade& cascade, cv::Mat& image, cv::Mat& mask, const DetectionOptions& options = DetectionOptions())
+    {
+        var area = DetectionArea();
+        area.Mask = mask;
+        area.Regions.Add(GetMaskBounds(mask));
+
+        var windowCount = 0l;
+        return DetectObjects(cascade, image, area, options, windowCount);
+    }
+
+    /// @brief Sets the number of threads used for object detection. The thread pool is restarted if already running.
+    /// @param threadCount Thread count.
+    static void SetDetectionThreadCount(int threadCount)
+    {
+        if (threadPool.ThreadCount() != 0)
+            threadPool.Stop();
+
+        ThreadPool<DetectionArgs>::SetThreadCount(threadCount);
+    }
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Train.hpp"
+#include <System.Diagnostics.h>
+
+using namespace System::Diagnostics;
+
+namespace ViolaJones
+{
+    /// @brief Training benchmark result for a single feature search configuration.
+    struct FeatureSearchResult
+    {
+        FeatureSearchOptions Search;
+        double MsPerTree;
+        /// @brief Mean exponential loss exp(-y * F) of the boosted trees (the loss minimized by GentleBoost).
+        double TrainLoss;
+        double ValidationLoss;
+        /// @brief FPR at the benchmark min TPR.
+        float TrainFPR;
+        float ValidationFPR;
+    };
+
+    /// @brief Splits images with objects into training and validation images (every BENCHMARK_VALIDATION_IMAGE_STEP-th image is held out),
+    ///        so validation objects are never seen during training - not even differently jittered.
+    /// @param set Labeled dataset.
+    /// @param trainImages Training image indices.
+    /// @param valImages Validation image indices.
+    static void SplitBenchmarkImages(LabeledDataset& set, List<int>& trainImages, List<int>& valImages)
+    {
+        var objImageIdx = 0;
+        for (var imIdx = 0; imIdx < set.ImageCount(); imIdx++)
+        {
+            if (set.GetObjects(imIdx).Count() == 0)
+                continue;
+
+            if (objImageIdx % BENCHMARK_VALIDATION_IMAGE_STEP == BENCHMARK_VALIDATION_IMAGE_STEP - 1)
+                valImages.Add(imIdx);
+            else
+                trainImages.Add(imIdx);
+
+            objImageIdx++;
+        }
+    }
+
+    /// @brief Samples first stage training data (all positives and the same number of random negatives) into a new sample store.
+    /// @param cascade Empty cascade (its width / height ratio).
+    /// @param positives Positive dataset.
+    /// @param negatives Negative dataset.
+    /// @param sampleSize Canonical sample height.
+    /// @param samples Created sample store.
+    /// @return Sample labels.
+    static List<float> SampleBenchmarkData(Cascade& cascade, LabeledDataset& positives, LabeledDataset& negatives, int sampleSize, SampleStore& samples)
+    {
+        var sampleCols = SampleStore::GridCols(sampleSize, cascade.WidthHeightRatio);
+        samples = SampleStore(sampleSize, sampleCols, 2 * positives.Count());
+
+        var [tpConfs, _tpr] = SamplePositives(cascade, positives, samples, positives.Count());
+        var [fpConfs, _fpr] = SamplePositives(cascade, negatives, samples, 2 * positives.Count() - tpConfs.Count(), 0);
+
+        var labels = List<float>();
+        labels.Add(+1.0f, tpConfs.Count());
+        labels.Add(-1.0f, fpConfs.Count());
+        return labels;
+    }
+
+    /// @brief Boosts trees with the specified feature search and measures the training time and the quality of the boosted classifier.
+    ///        The time of the feature pool creation (if used) is included in the time per tree.
+    /// @param samples Training samples.
+    /// @param labels Training labels.
+    /// @param valSamples Validation samples (objects of held-out images, see SplitBenchmarkImages).
+    /// @param valLabels Validation labels.
+    /// @param treeDepth Tree depth.
+    /// @param treeCount Number of boosted trees.
+    /// @param minTPR Min TPR the FPR is measured at.
+    /// @param search Feature search options.
+    /// @return Benchmark result.
+    FeatureSearchResult BenchmarkFeatureSearch(SampleStore& samples, List<float>& labels, SampleStore& valSamples, List<float>& valLabels,
+                                               int treeDepth, int treeCount, float minTPR, const FeatureSearchOptions& search)
+    {
+        var outputs = List<float>(), valOutputs = List<float>();
+        outputs.Add(0.0f, labels.Count());
+        valOutputs.Add(0.0f, valLabels.Count());
+
+        var trainMs = 0.0;
+
+        var pool = FeaturePool();
+        if (search.PoolSize > 0)
+        {
+            var start = Stopwatch::TotalMilliseconds();
+            pool = CreateFeaturePool(samples, search.PoolSize);
+            trainMs += Stopwatch::TotalMilliseconds() - start;
+        }
+
+        for (var treeIdx = 0; treeIdx < treeCount; treeIdx++)
+        {
+            var weights = WeightSamples(labels, outputs);
+
+            var start = Stopwatch::TotalMilliseconds();
+            var tree = TrainTree(samples, labels, weights, treeDepth, search, pool);
+            trainMs += Stopwatch::TotalMilliseconds() - start;
+
+            var treeConfs = EvalTreeBatch(samples, tree);
+            for (var i = 0; i < samples.Count(); i++)
+                outputs[i] += treeConfs[i];
+
+            var valTreeConfs = EvalTreeBatch(valSamples, tree);
+            for (var i = 0; i < valSamples.Count(); i++)
+                valOutputs[i] += valTreeConfs[i];
+        }
+
+        var result = FeatureSearchResult();
+        result.Search = search;
+        result.MsPerTree = trainMs / treeCount;
+
+        for (var i = 0; i < labels.Count(); i++)
+            result.TrainLoss += Math::Exp(-labels[i] * outputs[i]) / labels.Count();
+
+        for (var i = 0; i < valLabels.Count(); i++)
+            result.ValidationLoss += Math::Exp(-valLabels[i] * valOutputs[i]) / valLabels.Count();
+
+        var _ = 0.0f;
+        Tie<float, float, float>(_, result.TrainFPR, _) = SearchROC(labels, outputs, minTPR);
+        Tie<float, float, float>(_, result.ValidationFPR, _) = SearchROC(valLabels, valOutputs, minTPR);
+        return result;
+    }
+
+    /// @brief Formats benchmark results as a table.
+    /// @param results Benchmark results.
+    /// @param minTPR Min TPR the FPR is measured at.
+    /// @return Table (one row per feature search configuration).
+    string FeatureSearchReport(List<FeatureSearchResult>& results, float minTPR)
+    {
+        var tprStr = String(minTPR, 2);
+        var str = ((string)"search").PadRight(12) + ((string)"features").PadLeft(10) + ((string)"pool").PadLeft(8) + ((string)"ms/tree").PadLeft(10) +
+                  ((string)"loss").PadLeft(10) + ((string)"val loss").PadLeft(10) + ((string)"FPR@" + tprStr).PadLeft(12) + ((string)"val FPR@" + tprStr).PadLeft(14) + "\n";
+
+        for (var& r: results)
+        {
+            var name = (string)((r.Search.PoolSize > 0) ? "pool" : (r.Search.IsSuccessiveHalving ? "halving" : "exhaustive"));
+            str = str + name.PadRight(12) + String(r.Search.FeatureCount).PadLeft(10) + String(r.Search.PoolSize).PadLeft(8) + String(r.MsPerTree, 1).PadLeft(10) +
+                  String(r.TrainLoss, 4).PadLeft(10) + String(r.ValidationLoss, 4).PadLeft(10) +
+                  String(r.TrainFPR, 4).PadLeft(12) + String(r.ValidationFPR, 4).PadLeft(14) + "\n";
+        }
+
+        return str;
+    }
+}
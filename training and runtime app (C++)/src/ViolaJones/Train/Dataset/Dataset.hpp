@@ -6,6 +6,10 @@
 
 #include "../../Shared/Config.hpp"
 #include "Transforms.hpp"
+#include "ImageCache.hpp"
+#include "PackedDataset.hpp"
+#include "ImagePrefetcher.hpp"
+#include "DatasetManifest.hpp"
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
@@ -26,10 +30,19 @@ namespace ViolaJones
             /// @brief Constructs new labeled dataset. 
             /// @param dbFolder Database folder recursively scanned for images.
             /// @param whRatio Width height ratio for ROIs.
-            LabeledDataset(const string& dbFolder, float whRatio = -1)
+            /// @param imageCacheMB Memory budget (MB) of the decoded image cache. If 0, images are decoded on each request.
+            /// @param usePackedFile If true and the database folder contains a packed dataset (see PACKED_DATASET_FILE_NAME), the packed file is used instead of the folder content.
+            LabeledDataset(const string& dbFolder, float whRatio = -1, int imageCacheMB = 0, bool usePackedFile = true)
+                :imageCache((long)imageCacheMB * 1024 * 1024)
             {
                 this->dbFolder = dbFolder;
-                FillData(whRatio);
+
+                var packedFile = Path::Combine(dbFolder, PACKED_DATASET_FILE_NAME);
+                if (usePackedFile && File::Exists(packedFile))
+                    FillPackedData(packedFile, whRatio);
+                else
+                    FillData(whRatio);
+
                 this->whRatio = whRatio;
             }
 
@@ -43,6 +56,42 @@ namespace ViolaJones
                 throw NotImplementedException((string)"A derived class must implement this method.");
             }
 
+            /// @brief Gets decoded image cache counters (hits, misses and decode time).
+            /// @return Cache statistics.
+            ImageCacheStats CacheStats()
+            {
+                return imageCache.Stats();
+            }
+
+            /// @brief Resets decoded image cache counters, e.g. at the beginning of a stage.
+            void ResetCacheStats()
+            {
+                imageCache.ResetStats();
+            }
+
+            /// @brief Gets a number of images.
+            /// @return Image count.
+            int ImageCount()
+            {
+                return imgFiles.Count();
+            }
+
+            /// @brief Gets an image file name (for a packed dataset: the packed file name and the image index).
+            /// @param imIdx Image index.
+            /// @return Image file.
+            string& ImageFile(int imIdx)
+            {
+                return imgFiles[imIdx];
+            }
+
+            /// @brief Gets labeled object ROIs of an image.
+            /// @param imIdx Image index.
+            /// @return Object ROIs (normalized).
+            List<Rect>& GetObjects(int imIdx)
+            {
+                return rois[imIdx];
+            }
+
         protected:
             /// @brief Database folder.
             string dbFolder;
@@ -53,100 +102,145 @@ namespace ViolaJones
             List<string> imgFiles;
             /// @brief A collection of object bounds for each image.
             Objects rois;
+            /// @brief Decoded grayscale images (LRU).
+            ImageCache imageCache;
+            /// @brief Memory mapped packed dataset (if used instead of the database folder).
+            PackedDataset packed;
+            bool isPacked = false;
 
-            /// @brief Constructs new labeled dataset using an already created set. 
+            /// @brief Constructs new labeled dataset using an already created set. The image cache is not shared - the new dataset gets an empty cache with the same budget.
             /// @param set Labeled dataset.
             LabeledDataset(LabeledDataset& set)
+                :imageCache(set.imageCache)
             {
                 this->dbFolder = set.dbFolder;
                 this->whRatio = set.whRatio;
 
                 this->imgFiles = set.imgFiles;
                 this->rois = set.rois;
+
+                this->packed = set.packed;
+                this->isPacked = set.isPacked;
             }
 
-            /// @brief Loads an image as grayscale using a provided index.
+            /// @brief Loads an image as grayscale using a provided index (from the image cache if cached). The image must not be modified.
+            ///        Uncompressed packed images are read directly from the mapped file (neither decoded nor cached).
             /// @param imFileIdx Image index.
             /// @return Grayscale image.
             cv::Mat ReadGrayImage(int imFileIdx)
             {
-                var imFile = imgFiles[imFileIdx];
-                var im = cv::imread(cv::String(imFile.Ptr(), imFile.Length()), cv::IMREAD_GRAYSCALE);
+                if (IsDecodingFree())
+                    return packed.GetImage(imFileIdx);
+
+                if (isPacked)
+                    return imageCache.Get(imFileIdx, imgFiles[imFileIdx], [&]() { return packed.DecodeImage(imFileIdx); });
+
+                return imageCache.Get(imFileIdx, imgFiles[imFileIdx]);
+            }
+
+            /// @brief Decodes an image as grayscale without the image cache (the image is neither looked up nor cached).
+            /// @param imFileIdx Image index.
+            /// @return Grayscale image.
+            cv::Mat DecodeGrayImage(int imFileIdx)
+            {
+                var& imFile = imgFiles[imFileIdx];
+                var im = isPacked ? packed.DecodeImage(imFileIdx) : cv::imread(cv::String(imFile.Ptr(), imFile.Length()), cv::IMREAD_GRAYSCALE);
                 if (im.empty())
                     throw Exception("Can not open the specified image: " + imFile);
-        
+
                 return im;
             }
 
-            /// @brief Initializes dataset by reading image file names and parsing their label file.
+            /// @brief Checks whether images are read without any decoding (uncompressed packed dataset).
+            /// @return True if reading an image is free, false otherwise.
+            bool IsDecodingFree()
+            {
+                return isPacked && packed.Compression() == PackedCompression::None;
+            }
+
+            /// @brief Initializes dataset from a packed dataset file (see the Pack app) - images are not decoded, only the index is read.
+            /// @param packedFile Packed dataset file.
             /// @param whRatio Width height ratio to enforce to a read object ROI.
-            void FillData(float whRatio)
+            void FillPackedData(const string& packedFile, float whRatio)
             {
-                var allFiles = Directory::GetFiles(dbFolder, "", true);
+                packed = PackedDataset(packedFile);
+                isPacked = true;
                 var nROIs = 0;
 
-                for (var i = 0; i < allFiles.Count(); i++)
+                if (packed.IsSourceChanged(dbFolder))
+                    Console::Warning((string)"\tThe database folder changed since it was packed (images or labels were added, removed or modified) - re-run the Pack app, the packed content is used: " + packedFile);
+
+                for (var i = 0; i < packed.Count(); i++)
                 {
-                    var& file = allFiles[i];
-                    var isIm = file.EndsWith(".jpg") || file.EndsWith(".bmp") || file.EndsWith(".png");
-                    if (!isIm) 
-                        continue;
+                    imgFiles.Add(packedFile + "#" + i);
+                    rois.Add(AdjustROIs(packed.GetObjects(i), whRatio));
+                    nROIs += rois[i].Count();
+                }
 
-                    imgFiles.Add(file);
+                Console::WriteLine((string)"\tPacked dataset: " + packedFile);
+                Console::WriteLine((string)"\tImage count:  " + imgFiles.Count());
+                Console::WriteLine((string)"\tObject count: " + nROIs);
+            }
 
-                    var [p, f, e] = Path::FileParts(file);
-                    var lblPath = Path::Combine(p, f + ".txt");
+            /// @brief Initializes dataset by reading image file names and parsing their label file.
+            ///        The content is taken from the dataset manifest (see DatasetManifest) if the folder did not change since it was written, otherwise the folder is scanned and the manifest is re-written.
+            /// @param whRatio Width height ratio to enforce to a read object ROI.
+            void FillData(float whRatio)
+            {
+                var manifestFile = Path::Combine(dbFolder, DATASET_MANIFEST_FILE_NAME);
+                var manifest = DatasetManifest();
+                var isLoaded = false;
 
-                    if (File::Exists(lblPath) == false)
+                if (File::Exists(manifestFile))
+                {
+                    try
+                    {
+                        manifest = DatasetManifest::FromFile(manifestFile);
+                        isLoaded = manifest.IsUpToDate(dbFolder);
+                    }
+                    catch (IOException& ex)
                     {
-                        rois.Add(List<Rect>());
-                        continue;
+                        Console::Warning((string)"\tThe dataset manifest can not be read and it will be re-created: " + (string)ex);
                     }
+                }
 
-                    var rects = ParseImageROIs(lblPath, whRatio);
-                    rois.Add(rects);
-                    nROIs += rects.Count();
+                if (isLoaded)
+                    Console::WriteLine((string)"\tDataset manifest: " + manifestFile);
+                else
+                {
+                    Console::WriteLine((string)"\tReading data...");
 
-                    Console::Progress((float)i / allFiles.Count(), (string)"\tReading data...");
-                }
+                    //the manifest is created before the scan, so its creation does not change the database folder stamp
+                    var isWritable = true;
+                    try
+                    {
+                        if (File::Exists(manifestFile) == false)
+                            DatasetManifest().ToFile(manifestFile);
+                    }
+                    catch (IOException&)
+                    {
+                        isWritable = false;
+                    }
 
-                Console::Progress(1.0f, (string)"\tReading data...");
-                Console::WriteLine((string)"\tImage count:  " + imgFiles.Count());
-                Console::WriteLine((string)"\tObject count: " + nROIs);
-            }
+                    manifest = DatasetManifest::Scan(dbFolder);
 
-            /// @brief Parses label file which stores object ROIs in YOLOv3 format.
-            /// @param lblFile Label file.
-            /// @param whRatio Width height ratio to enforce.
-            /// @return A collection of object ROIs.
-            List<Rect> ParseImageROIs(string& lblFile, float whRatio)
-            {
-                List<Rect> rects;
-                var rows = File::ReadAllLines(lblFile);
+                    if (isWritable)
+                        manifest.ToFile(manifestFile);
+                    else
+                        Console::Warning((string)"\tThe dataset manifest can not be written (the database folder is read-only?): " + manifestFile);
+                }
+
+                imgFiles = manifest.ImageFiles;
+                var nROIs = 0;
 
-                for (var row: rows)
+                for (var i = 0; i < imgFiles.Count(); i++)
                 {
-                    var elements = row<-Split({' '});
-                    if (elements.Count() != 5)
-                        throw Exception("Invalid ROI: " + row);
-
-                    float c  = String::ParseInt32(elements[0]);
-                    float cX = String::ParseDouble(elements[1]);
-                    float cY = String::ParseDouble(elements[2]);
-                    float w  = String::ParseDouble(elements[3]);
-                    float h  = String::ParseDouble(elements[4]);
-
-                    if (whRatio != -1)
-                        w = whRatio * h;
-                    
-                    if (w == 0.0 || h == 0.0)
-                        continue;
-
-                    var rect = Rect { .CenterX = cX, .CenterY = cY, .Width = w, .Height = h };
-                    rects.Add(rect);
+                    rois.Add(AdjustROIs(manifest.Rois[i], whRatio));
+                    nROIs += rois[i].Count();
                 }
 
-                return rects;
+                Console::WriteLine((string)"\tImage count:  " + imgFiles.Count());
+                Console::WriteLine((string)"\tObject count: " + nROIs);
             }
 
             /// @brief Gets an image patch using the provided ROI.
@@ -176,6 +270,22 @@ namespace ViolaJones
             }
     };
 
+    /// @brief Placement of a cached object crop within its image.
+    struct CropRegion
+    {
+        /// @brief Top-left corner of the crop (image pixels).
+        int X;
+        int Y;
+        /// @brief Size of the image the crop is cut from.
+        int ImageWidth;
+        int ImageHeight;
+        /// @brief Crop pixels per image pixel (<= 1).
+        double Scale;
+    };
+
+    class PositiveDataset;
+    using CacheCropsArgs = Tuple<PositiveDataset&, List<int>&, int, List<cv::Mat>&>;
+
     /// @brief Dataset for positive samples.
     class PositiveDataset: public LabeledDataset
     {
@@ -201,7 +311,19 @@ namespace ViolaJones
                 FillObjIndices();
             }
 
+            /// @brief Creates new dataset using objects of selected images of an already initialized labeled dataset (e.g. to hold out validation images).
+            /// @param set Labeled dataset.
+            /// @param imageIndices Indices of images whose objects are used (ascending).
+            /// @param roiTransform An optional ROI transform.
+            PositiveDataset(LabeledDataset& set, List<int>& imageIndices, RoiTransform* roiTransform = null)
+                :LabeledDataset(set)
+            {
+                this->roiTransform = roiTransform;
+                FillObjIndices(imageIndices);
+            }
+
             /// @brief Gets an grayscale image patch.
+            ///        If the crops are cached (see CacheCrops), the patch is cut from the cached crop of the object (no image is read) and it must not be modified.
             /// @param index Object index.
             /// @return Grayscale image patch.
             cv::Mat operator [](int index) override
@@ -212,16 +334,65 @@ namespace ViolaJones
                 var imgIdx = objImgIndices[index];
                 var objIdx = objRoiIndices[index];
 
-                var grayIm = ReadGrayImage(imgIdx);
                 var rect = rois[imgIdx][objIdx];
-
                 if (roiTransform != null)
                     rect = roiTransform->Transform(rect);
 
+                if (crops.Count() > 0)
+                    return GetCropPatch(index, rect);
+
+                var grayIm = ReadGrayImage(imgIdx);
                 var patch = GetPatch(grayIm, rect);
                 return patch;
             }
 
+            /// @brief Cuts a padded crop around each object once and keeps it in memory, so patches are then cut from the crops (see the index operator).
+            ///        A crop covers every ROI the ROI transform can produce (see RoiTransform::MaxBounds) and objects higher than maxObjectSize are downscaled.
+            ///        Patches cut from a downscaled crop read area-averaged pixels, not the ones the detector reads; crops kept in the original resolution give identical patches.
+            ///        Each image is read once (images are processed in parallel if enabled).
+            /// @param maxObjectSize Max object height (px) within a crop. If 0, crops are kept in the original resolution.
+            void CacheCrops(int maxObjectSize)
+            {
+                if (maxObjectSize < 0)
+                    throw ArgumentException((string)"The max object size of cached crops must not be negative.");
+
+                var start = Stopwatch::TotalMilliseconds();
+
+                //index of the first object of each image (objects of an image are consecutive)
+                var firstObjIndices = List<int>();
+                firstObjIndices.Add(-1, imgFiles.Count());
+                for (var i = (int)objImgIndices.Count() - 1; i >= 0; i--)
+                    firstObjIndices[objImgIndices[i]] = i;
+
+                var imCrops = List<cv::Mat>();
+                imCrops.Add(cv::Mat(), Count());
+                cropRegions = List<CropRegion>();
+                cropRegions.Add(CropRegion(), Count());
+
+#ifndef PARALLEL
+                for (var imIdx = 0; imIdx < imgFiles.Count(); imIdx++)
+                    CacheImageCrops(imIdx, firstObjIndices[imIdx], maxObjectSize, imCrops);
+#else
+                var args = CacheCropsArgs(*this, firstObjIndices, maxObjectSize, imCrops);
+                Parallel<CacheCropsArgs>::For(0, imgFiles.Count(), [](CacheCropsArgs args, long imIdx, bool& shouldCancel)
+                {
+                    var& [set, firstObjIndices, maxObjectSize, imCrops] = args;
+                    set.CacheImageCrops(imIdx, firstObjIndices[imIdx], maxObjectSize, imCrops);
+                },
+                args);
+#endif
+
+                crops = imCrops;
+                imageCache.Clear(); //images are not read anymore
+
+                var memorySize = 0l;
+                for (var& crop: crops)
+                    memorySize += (long)crop.total();
+
+                Console::WriteLine((string)"\tPositive crops: " + (int)crops.Count() + " (" + String((double)memorySize / (1024 * 1024), 1) + " MB, " + 
+                                   String((double)(Stopwatch::TotalMilliseconds() - start) / 1000, 1) + " s)");
+            }
+
             /// @brief Gets a number of objects.
             /// @return Object count.
             long Count() override
@@ -234,26 +405,110 @@ namespace ViolaJones
             List<int> objImgIndices;
             List<int> objRoiIndices;
 
+            /// @brief Cached object crops (by an object index). Empty if crops are not cached.
+            List<cv::Mat> crops;
+            /// @brief Image regions covered by the cached crops (by an object index).
+            List<CropRegion> cropRegions;
+
+            /// @brief Creates crops of all objects of an image (see CacheCrops).
+            /// @param imIdx Image index.
+            /// @param firstObjIdx Index of the first object of the image (-1 if the image has no objects).
+            /// @param maxObjectSize Max object height (px) within a crop (0 to keep the original resolution).
+            /// @param imCrops Created crops (by an object index).
+            void CacheImageCrops(int imIdx, int firstObjIdx, int maxObjectSize, List<cv::Mat>& imCrops)
+            {
+                if (firstObjIdx < 0)
+                    return;
+
+                var grayIm = ReadGrayImage(imIdx);
+                var [imW, imH] = grayIm.size();
+
+                for (var objIdx = firstObjIdx; objIdx < Count() && objImgIndices[objIdx] == imIdx; objIdx++)
+                {
+                    var& rect = rois[imIdx][objRoiIndices[objIdx]];
+                    var bounds = (roiTransform != null) ? roiTransform->MaxBounds(rect) : rect;
+
+                    //crop region snapped to image pixels
+                    int x0 = Math::Max(0,   (int)Math::Floor((bounds.CenterX - bounds.Width  / 2) * imW));
+                    int y0 = Math::Max(0,   (int)Math::Floor((bounds.CenterY - bounds.Height / 2) * imH));
+                    int x1 = Math::Min(imW, (int)Math::Ceil((bounds.CenterX + bounds.Width  / 2) * imW));
+                    int y1 = Math::Min(imH, (int)Math::Ceil((bounds.CenterY + bounds.Height / 2) * imH));
+
+                    var crop = grayIm(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+                    var scale = (maxObjectSize > 0) ? Math::Min(1.0, (double)maxObjectSize / (rect.Height * imH)) : 1.0;
+                    cropRegions[objIdx] = CropRegion { .X = x0, .Y = y0, .ImageWidth = imW, .ImageHeight = imH, .Scale = scale };
+
+                    if (scale < 1)
+                    {
+                        var size = cv::Size(Math::Max(1, (int)Math::Round(crop.cols * scale)), Math::Max(1, (int)Math::Round(crop.rows * scale)));
+                        cv::resize(crop, imCrops[objIdx], size, 0, 0, cv::INTER_AREA);
+                    }
+                    else
+                        imCrops[objIdx] = crop.clone();
+                }
+            }
+
+            /// @brief Gets a patch from a cached object crop.
+            /// @param index Object index.
+            /// @param rect Patch ROI (normalized by the image size).
+            /// @return Image patch (shares data with the crop).
+            cv::Mat GetCropPatch(int index, Rect& rect)
+            {
+                var& crop = crops[index];
+                var& region = cropRegions[index];
+
+                //image pixels the same way as GetPatch does - then mapped into the crop
+                int imX = (rect.CenterX - rect.Width  / 2) * region.ImageWidth;
+                int imY = (rect.CenterY - rect.Height / 2) * region.ImageHeight;
+                int imW = rect.Width  * region.ImageWidth;
+                int imH = rect.Height * region.ImageHeight;
+
+                int x = Math::Min(Math::Max(0, (int)((imX - region.X) * region.Scale)), crop.cols - 1);
+                int y = Math::Min(Math::Max(0, (int)((imY - region.Y) * region.Scale)), crop.rows - 1);
+                int w = Math::Min(Math::Max(1, (int)(imW * region.Scale)), crop.cols - x);
+                int h = Math::Min(Math::Max(1, (int)(imH * region.Scale)), crop.rows - y);
+
+                if (imW == 0 || imH == 0)
+                    throw ArgumentException((string)"Can not get a patch. The specified ROI has zero size.");
+
+                return crop(cv::Rect(x, y, w, h));
+            }
+
             /// @brief Initializes image and ROI indices collections. 
             ///        A user provided index is then mapped to an image and its object.
             void FillObjIndices()
             {
                 for (var i = 0; i < imgFiles.Count(); i++)
+                    AddObjIndices(i);
+            }
+
+            /// @brief Initializes image and ROI indices collections using only the selected images.
+            /// @param imageIndices Image indices (ascending, so objects of an image stay consecutive).
+            void FillObjIndices(List<int>& imageIndices)
+            {
+                for (var i: imageIndices)
                 {
-                    if (rois[i].Count() == 0)
-                        continue; //skip negative samples
+                    if (i < 0 || i >= imgFiles.Count())
+                        throw IndexOutOfRangeException();
 
-                    for (var j = 0; j < rois[i].Count(); j++)
-                    {
-                        objImgIndices.Add(i);
-                        objRoiIndices.Add(j);
-                    }
+                    AddObjIndices(i);
+                }
+            }
+
+            /// @brief Adds indices of all objects of an image (images without objects are skipped).
+            /// @param imIdx Image index.
+            void AddObjIndices(int imIdx)
+            {
+                for (var j = 0; j < rois[imIdx].Count(); j++)
+                {
+                    objImgIndices.Add(imIdx);
+                    objRoiIndices.Add(j);
                 }
             }
     };
 
     /// @brief Dataset for negatives sampling.
-    class NegativeDataset: public LabeledDataset
+    class NegativeDataset: public LabeledDataset, public ImageLoader
     {
         public:
             /// @brief Creates and initializes new dataset.
@@ -275,13 +530,89 @@ namespace ViolaJones
                 this->minH = minH;
             }
 
+            ~NegativeDataset()
+            {
+                if (prefetcher != null)
+                    delete prefetcher;
+            }
+
+            //the dataset owns its prefetcher, which references the dataset - it can not be copied
+            NegativeDataset(const NegativeDataset& other) = delete;
+
+            NegativeDataset& operator = (const NegativeDataset&) = delete;
+
+            /// @brief Starts reading and decoding random images on dedicated I/O threads ahead of the patch sampling (see ImagePrefetcher).
+            ///        Patches are then cut from the prefetched images and an image is never decoded by a sampling thread.
+            /// @param threadCount Number of I/O threads.
+            /// @param depth Max number of images loaded ahead.
+            void StartPrefetch(int threadCount, int depth)
+            {
+                if (prefetcher != null)
+                    throw InvalidOperationException((string)"The prefetch is already started.");
+
+                prefetcher = new ImagePrefetcher(this, threadCount, depth);
+            }
+
+            /// @brief Checks whether images are prefetched.
+            /// @return True if the prefetch is started.
+            bool IsPrefetching()
+            {
+                return prefetcher != null;
+            }
+
+            /// @brief Gets prefetch counters (see StartPrefetch).
+            /// @return Prefetch statistics (empty if the prefetch is not started).
+            PrefetchStats PrefetcherStats()
+            {
+                return (prefetcher != null) ? prefetcher->Stats() : PrefetchStats();
+            }
+
+            /// @brief Resets prefetch counters, e.g. at the beginning of a stage.
+            void ResetPrefetcherStats()
+            {
+                if (prefetcher != null)
+                    prefetcher->ResetStats();
+            }
+
+            /// @brief Gets a number of images.
+            /// @return Image count.
+            int ImageCount() override
+            {
+                return LabeledDataset::ImageCount();
+            }
+
+            /// @brief Reads an image for the prefetcher (called from I/O threads).
+            ///        The image cache is bypassed - a prefetched image is used only while it is active (see NextPatchImage), so caching it would only evict other images.
+            ///        Uncompressed packed images are copied, so their (memory mapped) pages are read by the I/O thread.
+            /// @param imIdx Image index.
+            /// @return Grayscale image.
+            cv::Mat LoadImage(int imIdx) override
+            {
+                if (IsDecodingFree())
+                    return packed.GetImage(imIdx).clone();
+
+                return DecodeGrayImage(imIdx);
+            }
+
+            /// @brief Gets a random image - from the prefetch queue if the prefetch is started, otherwise it is read now. The image must not be modified.
+            /// @return Image and its index.
+            PrefetchedImage NextImage()
+            {
+                if (prefetcher != null)
+                    return prefetcher->Next();
+
+                var next = PrefetchedImage();
+                next.Index = RandomImageIndex();
+                next.Image = ReadGrayImage(next.Index);
+                return next;
+            }
+
             /// @brief Gets a grayscale image patch sampled from the image collection.
             /// @param _ Not used.
             /// @return Grayscale image patch.
             cv::Mat operator [](int _) override
             {
-                var imIdx = rand.Next(0, imgFiles.Count() - 1);
-                var grayIm = ReadGrayImage(imIdx);
+                var [imIdx, grayIm] = NextPatchImage();
 
                 var objROIs = rois[imIdx];        
                 Rect randROI;
@@ -291,7 +622,7 @@ namespace ViolaJones
                 {
                    randROI = GetRandomROI(grayIm.size(), minH, whRatio);
                 } 
-                while (GetMaxIOU(randROI, objROIs) >= 0.5); 
+                while (GetMaxIOU(randROI, objROIs) >= NEGATIVE_MAX_IOU); 
                       
                 var patch = GetPatch(grayIm, randROI);
                 return patch;
@@ -304,9 +635,150 @@ namespace ViolaJones
                 return 0x7FFFFFFF; //Negative dataset has an infinite amount of samples.
             }
 
+            /// @brief Gets a random image index.
+            /// @return Image index.
+            int RandomImageIndex()
+            {
+                return rand.Next(0, imgFiles.Count() - 1);
+            }
+
+            /// @brief Gets a decoded grayscale image (from the image cache if cached). The image must not be modified.
+            /// @param imIdx Image index.
+            /// @return Grayscale image.
+            cv::Mat GetImage(int imIdx)
+            {
+                return ReadGrayImage(imIdx);
+            }
+
+            /// @brief Gets a maximum IOU between the provided ROI and other object ROIs.
+            /// @param roi ROI of an object.
+            /// @param objRois Other ROIs.
+            /// @return Max IOU.
+            float GetMaxIOU(Rect& roi, List<Rect>& objRois)
+            {
+                var maxIOU = 0.0f;
+
+                for (var& objRoi: objRois)
+                {
+                    var iou = GetIOU(roi, objRoi);
+                    if (iou > maxIOU)
+                        maxIOU = iou;
+                }
+
+                return maxIOU;
+            }
+
+            /// @brief Gets a maximum part of an object ROI covered by the provided ROI (intersection over the object area).
+            ///        Unlike IOU, it is high for a ROI containing a (much smaller) object.
+            /// @param roi ROI of a patch.
+            /// @param objRois Object ROIs.
+            /// @return Max object coverage.
+            float GetMaxObjectCoverage(Rect& roi, List<Rect>& objRois)
+            {
+                var maxCoverage = 0.0f;
+
+                for (var& objRoi: objRois)
+                {
+                    var coverage = GetIntersectionArea(roi, objRoi) / (objRoi.Width * objRoi.Height);
+                    if (coverage > maxCoverage)
+                        maxCoverage = coverage;
+                }
+
+                return maxCoverage;
+            }
+
         private:
             int minH;
             Random rand;
+            ImagePrefetcher* prefetcher = null;
+
+            /// @brief Images patches are currently sampled from (if the image cache is enabled or images are prefetched).
+            List<int> activeImages;
+            /// @brief Prefetched active images (if images are prefetched).
+            List<cv::Mat> activeImageData;
+            /// @brief Number of patches which are still to be sampled from each active image.
+            List<int> activePatchCounts;
+            Mutex activeLock;
+
+            /// @brief Gets an image for the next patch.
+            ///        If images are prefetched, active images are replaced by prefetched ones. Each of them serves NEGATIVE_PATCHES_PER_PREFETCHED_IMAGE patches (the image cache is not used).
+            ///        If images are not prefetched, the image is read now (see NextImageIndex).
+            /// @return Image and its index.
+            PrefetchedImage NextPatchImage()
+            {
+                if (prefetcher == null)
+                {
+                    var next = PrefetchedImage();
+                    next.Index = NextImageIndex();
+                    next.Image = ReadGrayImage(next.Index);
+                    return next;
+                }
+
+                activeLock.Lock();
+
+                if (activeImages.Count() == 0)
+                {
+                    activeImages.Add(-1, NEGATIVE_ACTIVE_IMAGES);
+                    activeImageData.Add(cv::Mat(), NEGATIVE_ACTIVE_IMAGES);
+                    activePatchCounts.Add(0, NEGATIVE_ACTIVE_IMAGES);
+                }
+
+                var slot = Math::Min(rand.Next(0, NEGATIVE_ACTIVE_IMAGES), NEGATIVE_ACTIVE_IMAGES - 1);
+                if (activePatchCounts[slot] > 0)
+                {
+                    var active = PrefetchedImage();
+                    active.Index = activeImages[slot];
+                    active.Image = activeImageData[slot];
+                    activePatchCounts[slot]--;
+
+                    activeLock.Unlock();
+                    return active;
+                }
+
+                activeLock.Unlock();
+
+                //the slot is replaced outside of the lock, other threads may sample other slots meanwhile
+                var next = prefetcher->Next();
+
+                activeLock.Lock();
+                activeImages[slot] = next.Index;
+                activeImageData[slot] = next.Image;
+                activePatchCounts[slot] = NEGATIVE_PATCHES_PER_PREFETCHED_IMAGE - 1;
+                activeLock.Unlock();
+
+                return next;
+            }
+
+            /// @brief Gets an image index for the next patch. 
+            ///        If the image cache is enabled, patches are sampled from a small set of active images, each of which is replaced by a random image after NEGATIVE_PATCHES_PER_IMAGE patches,
+            ///        so a decoded image serves many patches. Otherwise (or if images are not decoded at all), each patch comes from a random image.
+            /// @return Image index.
+            int NextImageIndex()
+            {
+                if (imageCache.Budget() == 0 || IsDecodingFree())
+                    return rand.Next(0, imgFiles.Count() - 1);
+
+                activeLock.Lock();
+
+                if (activeImages.Count() == 0)
+                {
+                    activeImages.Add(0, NEGATIVE_ACTIVE_IMAGES);
+                    activePatchCounts.Add(0, NEGATIVE_ACTIVE_IMAGES);
+                }
+
+                var slot = Math::Min(rand.Next(0, NEGATIVE_ACTIVE_IMAGES), NEGATIVE_ACTIVE_IMAGES - 1);
+                if (activePatchCounts[slot] == 0)
+                {
+                    activeImages[slot] = rand.Next(0, imgFiles.Count() - 1);
+                    activePatchCounts[slot] = NEGATIVE_PATCHES_PER_IMAGE;
+                }
+
+                var imIdx = activeImages[slot];
+                activePatchCounts[slot]--;
+
+                activeLock.Unlock();
+                return imIdx;
+            }
 
             /// @brief Gets a random ROI provided the image size, minimal height and width/height ratio.
             /// @param imSize Image size.
@@ -332,29 +804,23 @@ namespace ViolaJones
                 };
             }
 
-            /// @brief Gets a maximum IOU between the provided ROI and other object ROIs.
-            /// @param roi ROI of an object.
-            /// @param objRois Other ROIs.
-            /// @return Max IOU.
-            float GetMaxIOU(Rect& roi, List<Rect>& objRois)
+            /// @brief Gets an IOU for two ROIs.
+            /// @param roiA First ROI.
+            /// @param roiB Second ROI.
+            /// @return IOU.
+            float GetIOU(Rect& roiA, Rect& roiB)
             {
-                var maxIOU = 0.0f;
-
-                for (var& objRoi: objRois)
-                {
-                    var iou = GetIOU(roi, objRoi);
-                    if (iou > maxIOU)
-                        maxIOU = iou;
-                }
+                var overArea = GetIntersectionArea(roiA, roiB);
 
-                return maxIOU;
+                var iou = overArea / (roiA.Width * roiA.Height + roiB.Width * roiB.Height - overArea);
+                return iou;
             }
 
-            /// @brief Gets an IOU for two ROIs.
+            /// @brief Gets an intersection area of two ROIs.
             /// @param roiA First ROI.
             /// @param roiB Second ROI.
-            /// @return IOU.
-            float GetIOU(Rect& roiA, Rect& roiB)
+            /// @return Intersection area.
+            float GetIntersectionArea(Rect& roiA, Rect& roiB)
             {
                 var [xCa, yCa, wa, ha] = roiA;
                 var [xCb, yCb, wb, hb] = roiB;
@@ -362,8 +828,7 @@ namespace ViolaJones
                 float overW = Math::Max(0.0f, Math::Min(xCa + wa / 2, xCb + wb / 2) - Math::Max(xCa - wa / 2, xCb - wb / 2));
                 float overH = Math::Max(0.0f, Math::Min(yCa + ha / 2, yCb + hb / 2) - Math::Max(yCa - ha / 2, yCb - hb / 2));
 
-                var iou = overW * overH / (wa * ha + wb * hb - overW * overH);
-                return iou;
+                return overW * overH;
             }
     };
 };
\ No newline at end of file
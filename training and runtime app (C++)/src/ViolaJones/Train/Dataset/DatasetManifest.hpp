@@ -0,0 +1,371 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.IO.h>
+#include <System.Threading.h>
+#include <sys/stat.h>
+#include "Util.hpp"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Threading;
+
+namespace ViolaJones
+{
+    /// @brief Dataset manifest file signature ('VJMF').
+    const Int32 DATASET_MANIFEST_MAGIC = 0x464D4A56;
+    /// @brief Dataset manifest format version.
+    const Int32 DATASET_MANIFEST_VERSION = 1;
+
+    /// @brief Gets the last modification time of a file or a directory.
+    /// @param path File or directory path.
+    /// @return Modification time (ns since epoch) combined with the size, or -1 if the path does not exist.
+    static Int64 GetModificationStamp(const string& path)
+    {
+        struct stat sb;
+        if (stat(path.Ptr(), &sb) != 0)
+            return -1;
+
+#ifdef __linux__
+        var nanoseconds = (Int64)sb.st_mtim.tv_nsec;
+#else
+        var nanoseconds = (Int64)0; //only seconds are available
+#endif
+
+        //the size catches most changes done within the same time unit
+        return ((Int64)sb.st_mtime * 1000000000 + nanoseconds) ^ ((Int64)sb.st_size << 1);
+    }
+
+    /// @brief Gets the label file of an image (image name with '.txt' ext).
+    /// @param imFile Image file.
+    /// @return Label file.
+    static string GetLabelFile(const string& imFile)
+    {
+        var [p, f, e] = Path::FileParts(imFile);
+        return Path::Combine(p, f + ".txt");
+    }
+
+    /// @brief Checks whether a file is an image of a database (by its extension).
+    /// @param file File.
+    /// @return True if the file is an image, false otherwise.
+    static bool IsImageFile(const string& file)
+    {
+        return file.EndsWith(".jpg") || file.EndsWith(".bmp") || file.EndsWith(".png");
+    }
+
+    /// @brief Parses label file which stores object ROIs in YOLOv3 format. ROIs are returned as labeled (see AdjustROIs).
+    /// @param lblFile Label file.
+    /// @return A collection of object ROIs.
+    static List<Rect> ParseImageROIs(const string& lblFile)
+    {
+        List<Rect> rects;
+        var rows = File::ReadAllLines(lblFile);
+
+        for (var row: rows)
+        {
+            var elements = row<-Split({' '});
+            if (elements.Count() != 5)
+                throw Exception("Invalid ROI: " + row);
+
+            float c  = String::ParseInt32(elements[0]);
+            float cX = String::ParseDouble(elements[1]);
+            float cY = String::ParseDouble(elements[2]);
+            float w  = String::ParseDouble(elements[3]);
+            float h  = String::ParseDouble(elements[4]);
+
+            var rect = Rect { .CenterX = cX, .CenterY = cY, .Width = w, .Height = h };
+            rects.Add(rect);
+        }
+
+        return rects;
+    }
+
+    /// @brief Enforces a width height ratio to labeled ROIs and skips ROIs of zero size.
+    /// @param rects Labeled ROIs.
+    /// @param whRatio Width height ratio to enforce (-1 to keep the labeled width).
+    /// @return Adjusted ROIs.
+    static List<Rect> AdjustROIs(List<Rect>& rects, float whRatio)
+    {
+        var adjusted = List<Rect>();
+        for (var rect: rects)
+        {
+            if (whRatio != -1)
+                rect.Width = whRatio * rect.Height;
+
+            if (rect.Width == 0.0 || rect.Height == 0.0)
+                continue;
+
+            adjusted.Add(rect);
+        }
+
+        return adjusted;
+    }
+
+    using ScanFolderArgs = Tuple<List<string>&, List<Int64>&, List<List<string>>&, List<List<string>>&>;
+    using ReadLabelsArgs = Tuple<List<string>&, List<Int64>&, List<List<Rect>>&, List<string>&>;
+    using CheckStampsArgs = Tuple<List<string>&, List<Int64>&, List<bool>&>;
+
+    /// @brief Content of a database folder: image files, their parsed label files and modification stamps of all folders and label files.
+    ///        It is written into the database folder and reused while no folder and no label file changes, so the folder is not scanned and labels are not parsed again.
+    ///        Layout: magic, version, folder count, (folder, stamp) pairs, image count, (image file, label stamp, ROI count, ROIs) tuples; strings are prefixed by their length.
+    class DatasetManifest
+    {
+        /// @brief Writes a string prefixed by its length.
+        static void WriteString(FileStream& fs, const string& str)
+        {
+            fs.WriteValue((Int32)str.Length());
+            fs.Write((byte*)str.Ptr(), str.Length());
+        }
+
+        /// @brief Reads a string prefixed by its length.
+        static string ReadString(FileStream& fs)
+        {
+            var length = fs.ReadValue<Int32>();
+            if (length < 0 || length > 4096)
+                throw IOException((string)"The dataset manifest is corrupted.");
+
+            char buff[4097] = { '\0' };
+            if (fs.Read((byte*)buff, length) != length)
+                throw IOException((string)"The dataset manifest is corrupted.");
+
+            return string(buff);
+        }
+
+        /// @brief Lists files and sub-folders of a folder. The folder stamp is taken before the listing, so a change during the scan is detected next time.
+        /// @param folder Folder.
+        /// @param stamp Modification stamp of the folder.
+        /// @param files Files of the folder.
+        /// @param subFolders Sub-folders of the folder.
+        static void ScanFolder(const string& folder, Int64& stamp, List<string>& files, List<string>& subFolders)
+        {
+            stamp = GetModificationStamp(folder);
+            files = Directory::GetFiles(folder, "", false);
+            subFolders = Directory::GetDirectories(folder);
+        }
+
+        /// @brief Reads the label file of an image (if exists).
+        /// @param imFile Image file.
+        /// @param labelStamp Modification stamp of the label file (-1 if there is no label file).
+        /// @param rects Parsed ROIs (empty if there is no label file).
+        /// @param error Error message if the label file can not be parsed (errors are not thrown from worker threads).
+        static void ReadLabels(const string& imFile, Int64& labelStamp, List<Rect>& rects, string& error)
+        {
+            var lblFile = GetLabelFile(imFile);
+            labelStamp = GetModificationStamp(lblFile);
+
+            try
+            {
+                if (labelStamp != -1)
+                    rects = ParseImageROIs(lblFile);
+            }
+            catch (Exception& ex)
+            {
+                error = lblFile + ": " + (string)ex;
+            }
+        }
+
+    public:
+        /// @brief Scanned folders (the database folder and all its sub-folders).
+        List<string> Folders;
+        /// @brief Modification stamps of the folders (a folder changes when a file is added, removed or renamed).
+        List<Int64> FolderStamps;
+
+        /// @brief Image files.
+        List<string> ImageFiles;
+        /// @brief Modification stamps of the label files (-1 if an image has no label file).
+        List<Int64> LabelStamps;
+        /// @brief Object ROIs of each image as labeled.
+        List<List<Rect>> Rois;
+
+        /// @brief Scans a database folder and parses all label files. Folders of the same depth are listed in parallel and label files are parsed in parallel (if enabled).
+        /// @param dbFolder Database folder.
+        /// @return Manifest.
+        static DatasetManifest Scan(const string& dbFolder)
+        {
+            if (Directory::Exists(dbFolder) == false)
+                throw IOException("The specified directory: '" + dbFolder + "' does not exist.");
+
+            var manifest = DatasetManifest();
+            var allFiles = List<string>();
+
+            //folders are scanned level by level
+            var level = List<string>{ dbFolder };
+            while (level.Count() > 0)
+            {
+                var levelStamps = List<Int64>();
+                levelStamps.Add(-1, level.Count());
+                var levelFiles = List<List<string>>(), levelFolders = List<List<string>>();
+                levelFiles.Add(List<string>(), level.Count());
+                levelFolders.Add(List<string>(), level.Count());
+
+#ifndef PARALLEL
+                for (var i = 0; i < level.Count(); i++)
+                    ScanFolder(level[i], levelStamps[i], levelFiles[i], levelFolders[i]);
+#else
+                var args = ScanFolderArgs(level, levelStamps, levelFiles, levelFolders);
+                Parallel<ScanFolderArgs>::For(0, level.Count(), [](ScanFolderArgs args, long i, bool& shouldCancel)
+                {
+                    var& [level, levelStamps, levelFiles, levelFolders] = args;
+                    ScanFolder(level[i], levelStamps[i], levelFiles[i], levelFolders[i]);
+                },
+                args);
+#endif
+
+                var nextLevel = List<string>();
+                for (var i = 0; i < level.Count(); i++)
+                {
+                    manifest.Folders.Add(level[i]);
+                    manifest.FolderStamps.Add(levelStamps[i]);
+                    allFiles.AddRange(levelFiles[i]);
+                    nextLevel.AddRange(levelFolders[i]);
+                }
+
+                level = nextLevel;
+            }
+
+            for (var& file: allFiles)
+            {
+                if (IsImageFile(file))
+                    manifest.ImageFiles.Add(file);
+            }
+
+            //label files
+            var errors = List<string>();
+            errors.Add(string(), manifest.ImageFiles.Count());
+            manifest.LabelStamps.Add(-1, manifest.ImageFiles.Count());
+            manifest.Rois.Add(List<Rect>(), manifest.ImageFiles.Count());
+
+#ifndef PARALLEL
+            for (var i = 0; i < manifest.ImageFiles.Count(); i++)
+                ReadLabels(manifest.ImageFiles[i], manifest.LabelStamps[i], manifest.Rois[i], errors[i]);
+#else
+            var args = ReadLabelsArgs(manifest.ImageFiles, manifest.LabelStamps, manifest.Rois, errors);
+            Parallel<ReadLabelsArgs>::For(0, manifest.ImageFiles.Count(), [](ReadLabelsArgs args, long i, bool& shouldCancel)
+            {
+                var& [imageFiles, labelStamps, rois, errors] = args;
+                ReadLabels(imageFiles[i], labelStamps[i], rois[i], errors[i]);
+            },
+            args);
+#endif
+
+            for (var& error: errors)
+            {
+                if (error.Length() > 0)
+                    throw Exception(error);
+            }
+
+            return manifest;
+        }
+
+        /// @brief Loads a manifest written by ToFile.
+        /// @param manifestFile Manifest file.
+        /// @return Manifest.
+        static DatasetManifest FromFile(const string& manifestFile)
+        {
+            var fs = FileStream(manifestFile, FileMode::ReadOnly);
+            var manifest = DatasetManifest();
+
+            if (fs.ReadValue<Int32>() != DATASET_MANIFEST_MAGIC || fs.ReadValue<Int32>() != DATASET_MANIFEST_VERSION)
+                throw IOException("Unsupported dataset manifest: " + manifestFile);
+
+            var folderCount = fs.ReadValue<Int32>();
+            for (var i = 0; i < folderCount; i++)
+            {
+                manifest.Folders.Add(ReadString(fs));
+                manifest.FolderStamps.Add(fs.ReadValue<Int64>());
+            }
+
+            var imageCount = fs.ReadValue<Int32>();
+            for (var i = 0; i < imageCount; i++)
+            {
+                manifest.ImageFiles.Add(ReadString(fs));
+                manifest.LabelStamps.Add(fs.ReadValue<Int64>());
+
+                var rects = List<Rect>();
+                var roiCount = fs.ReadValue<Int32>();
+                for (var j = 0; j < roiCount; j++)
+                    rects.Add(fs.ReadValue<Rect>());
+
+                manifest.Rois.Add(rects);
+            }
+
+            if (fs.IsEOF() == false)
+                throw IOException("The dataset manifest is corrupted: " + manifestFile);
+
+            return manifest;
+        }
+
+        /// @brief Writes the manifest.
+        /// @param manifestFile Manifest file.
+        void ToFile(const string& manifestFile)
+        {
+            var fs = FileStream(manifestFile, FileMode::WriteOnly);
+            fs.WriteValue(DATASET_MANIFEST_MAGIC);
+            fs.WriteValue(DATASET_MANIFEST_VERSION);
+
+            fs.WriteValue((Int32)Folders.Count());
+            for (var i = 0; i < Folders.Count(); i++)
+            {
+                WriteString(fs, Folders[i]);
+                fs.WriteValue(FolderStamps[i]);
+            }
+
+            fs.WriteValue((Int32)ImageFiles.Count());
+            for (var i = 0; i < ImageFiles.Count(); i++)
+            {
+                WriteString(fs, ImageFiles[i]);
+                fs.WriteValue(LabelStamps[i]);
+
+                fs.WriteValue((Int32)Rois[i].Count());
+                for (var& rect: Rois[i])
+                    fs.WriteValue(rect);
+            }
+        }
+
+        /// @brief Checks whether the database folder is unchanged since the manifest was created: the manifest was scanned from the same folder path and no folder and no label file has a different modification stamp.
+        ///        Label files are checked in parallel (if enabled) - each into its own result slot, which are reduced afterwards. A label file added to an existing image changes the folder stamp.
+        ///        Paths are stored as scanned, hence a manifest copied or moved with the folder (or the folder referenced by another path) is not used.
+        /// @param dbFolder Database folder the manifest is read for.
+        /// @return True if the manifest may be used, false if the folder must be scanned again.
+        bool IsUpToDate(const string& dbFolder)
+        {
+            if (Folders.Count() == 0 || Folders[0] != dbFolder)
+                return false;
+
+            for (var i = 0; i < Folders.Count(); i++)
+            {
+                if (GetModificationStamp(Folders[i]) != FolderStamps[i])
+                    return false;
+            }
+
+#ifndef PARALLEL
+            for (var i = 0; i < ImageFiles.Count(); i++)
+            {
+                if (LabelStamps[i] != -1 && GetModificationStamp(GetLabelFile(ImageFiles[i])) != LabelStamps[i])
+                    return false;
+            }
+#else
+            var changes = List<bool>();
+            changes.Add(false, ImageFiles.Count());
+
+            var args = CheckStampsArgs(ImageFiles, LabelStamps, changes);
+            Parallel<CheckStampsArgs>::For(0, ImageFiles.Count(), [](CheckStampsArgs args, long i, bool& shouldCancel)
+            {
+                var& [imageFiles, labelStamps, changes] = args;
+                changes[i] = labelStamps[i] != -1 && GetModificationStamp(GetLabelFile(imageFiles[i])) != labelStamps[i];
+            },
+            args);
+
+            for (var isChanged: changes)
+            {
+                if (isChanged)
+                    return false;
+            }
+#endif
+
+            return true;
+        }
+    };
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.Threading.h>
+#include <System.Diagnostics.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+using namespace System::Diagnostics;
+
+namespace ViolaJones
+{
+    /// @brief Image cache counters.
+    struct ImageCacheStats
+    {
+        long HitCount = 0;
+        long MissCount = 0;
+        /// @brief Time spent reading and decoding images (summed over threads).
+        double DecodeMs = 0;
+
+        /// @brief Gets the ratio of image requests served from the cache.
+        /// @return Hit rate [0..1].
+        float HitRate()
+        {
+            var requestCount = HitCount + MissCount;
+            return (requestCount > 0) ? (float)HitCount / requestCount : 0.0f;
+        }
+    };
+
+    /// @brief Least recently used cache of decoded grayscale images bounded by a memory budget. Thread safe.
+    ///        Images are decoded outside of the lock, so concurrent misses do not wait for each other.
+    class ImageCache
+    {
+        /// @brief Decoded images by an image index (empty if not cached).
+        List<cv::Mat> images;
+        /// @brief Last use (a use counter value) by an image index.
+        List<long> lastUses;
+        /// @brief Indices of cached images.
+        List<int> cachedIndices;
+
+        long budget = 0;
+        long size = 0;
+        long useCounter = 0;
+        ImageCacheStats stats;
+        Mutex lockObj;
+
+        /// @brief Gets the memory occupied by an image.
+        /// @param im Image.
+        /// @return Number of bytes.
+        static long ImageSize(cv::Mat& im)
+        {
+            return (long)im.total() * im.elemSize();
+        }
+
+        /// @brief Evicts the least recently used images until the specified number of bytes fits into the budget. Must be called under the lock.
+        /// @param requiredSize Number of bytes to free.
+        void Evict(long requiredSize)
+        {
+            while (cachedIndices.Count() > 0 && size + requiredSize > budget)
+            {
+                var lruPos = 0;
+                for (var i = 1; i < cachedIndices.Count(); i++)
+                {
+                    if (lastUses[cachedIndices[i]] < lastUses[cachedIndices[lruPos]])
+                        lruPos = i;
+                }
+
+                var imIdx = cachedIndices[lruPos];
+                size -= ImageSize(images[imIdx]);
+                images[imIdx] = cv::Mat();
+
+                cachedIndices[lruPos] = cachedIndices[cachedIndices.Count() - 1];
+                cachedIndices.RemoveLast();
+            }
+        }
+
+    public:
+        /// @brief Creates a new cache.
+        /// @param budget Memory budget in bytes. If 0, images are not cached (only the statistics are collected).
+        ImageCache(long budget = 0)
+        {
+            this->budget = budget;
+        }
+
+        /// @brief Creates an empty cache with the same budget (images and statistics are not copied).
+        /// @param other Cache.
+        ImageCache(const ImageCache& other)
+        {
+            this->budget = other.budget;
+        }
+
+        /// @brief Gets the memory budget.
+        /// @return Number of bytes.
+        long Budget()
+        {
+            return budget;
+        }
+
+        /// @brief Gets a decoded grayscale image - from the cache or from the file (the image is then cached).
+        ///        The returned image shares its data with the cache, hence it must not be modified.
+        /// @param imIdx Image index.
+        /// @param imFile Image file.
+        /// @return Grayscale image.
+        cv::Mat Get(int imIdx, const string& imFile)
+        {
+            return Get(imIdx, imFile, [&]() { return cv::imread(cv::String(imFile.Ptr(), imFile.Length()), cv::IMREAD_GRAYSCALE); });
+        }
+
+        /// @brief Gets a decoded grayscale image - from the cache or by the provided decoder (the image is then cached).
+        ///        The returned image shares its data with the cache, hence it must not be modified.
+        /// @param imIdx Image index.
+        /// @param imName Image name (for error messages).
+        /// @param decode Function which decodes the image (returns an empty image on failure). Called outside of the lock.
+        /// @return Grayscale image.
+        template <typename TDecode>
+        cv::Mat Get(int imIdx, const string& imName, TDecode decode)
+        {
+            lockObj.Lock();
+            {
+                while (images.Count() <= imIdx)
+                {
+                    images.Add(cv::Mat());
+                    lastUses.Add(0);
+                }
+
+                if (!images[imIdx].empty())
+                {
+                    stats.HitCount++;
+                    lastUses[imIdx] = ++useCounter;
+
+                    var im = images[imIdx];
+                    lockObj.Unlock();
+                    return im;
+                }
+
+                stats.MissCount++;
+            }
+            lockObj.Unlock();
+
+            var start = Stopwatch::TotalNanoseconds();
+            cv::Mat im = decode();
+            var decodeMs = (double)(Stopwatch::TotalNanoseconds() - start) / 1e6;
+
+            if (im.empty())
+                throw Exception("Can not open the specified image: " + imName);
+
+            lockObj.Lock();
+            {
+                stats.DecodeMs += decodeMs;
+
+                //the image may be cached by another thread in the meantime
+                var imSize = ImageSize(im);
+                if (images[imIdx].empty() && imSize <= budget)
+                {
+                    Evict(imSize);
+
+                    images[imIdx] = im;
+                    lastUses[imIdx] = ++useCounter;
+                    cachedIndices.Add(imIdx);
+                    size += imSize;
+                }
+            }
+            lockObj.Unlock();
+
+            return im;
+        }
+
+        /// @brief Gets cache counters.
+        /// @return Cache statistics.
+        ImageCacheStats Stats()
+        {
+            lockObj.Lock();
+            var s = stats;
+            lockObj.Unlock();
+            return s;
+        }
+
+        /// @brief Removes all cached images (counters are kept).
+        void Clear()
+        {
+            lockObj.Lock();
+            images = List<cv::Mat>();
+            lastUses = List<long>();
+            cachedIndices = List<int>();
+            size = 0;
+            lockObj.Unlock();
+        }
+
+        /// @brief Resets cache counters (cached images are kept).
+        void ResetStats()
+        {
+            lockObj.Lock();
+            stats = ImageCacheStats();
+            lockObj.Unlock();
+        }
+    };
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.Threading.h>
+#include <System.Diagnostics.h>
+#include <opencv2/core.hpp>
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+using namespace System::Diagnostics;
+
+namespace ViolaJones
+{
+    /// @brief Source of images loaded by the prefetcher.
+    abstract class ImageLoader
+    {
+        public:
+            /// @brief Gets a number of images.
+            /// @return Image count.
+            virtual int ImageCount() = 0;
+
+            /// @brief Reads and decodes an image. Called concurrently from I/O threads.
+            /// @param imIdx Image index.
+            /// @return Grayscale image.
+            virtual cv::Mat LoadImage(int imIdx) = 0;
+    };
+
+    /// @brief Image (and its index) loaded ahead by the prefetcher.
+    struct PrefetchedImage
+    {
+        int Index = -1;
+        cv::Mat Image;
+    };
+
+    /// @brief Image prefetcher counters.
+    struct PrefetchStats
+    {
+        /// @brief Number of images taken from the queue.
+        long ImageCount = 0;
+        /// @brief Time spent by I/O threads reading and decoding images (summed over threads).
+        double LoadMs = 0;
+        /// @brief Time consumers waited for an image because the queue was empty (summed over consumer threads). If large, add I/O threads.
+        double StallMs = 0;
+        /// @brief Time I/O threads waited because the queue was full (summed over threads). If large, I/O is not the bottleneck.
+        double IdleMs = 0;
+    };
+
+    /// @brief Reads and decodes random images on dedicated I/O threads into a bounded queue, ahead of the (classification) threads consuming them. Thread safe.
+    class ImagePrefetcher
+    {
+        ImageLoader* loader;
+        int depth;
+        List<ThreadBase*> threads;
+
+        Queue<PrefetchedImage> queue;
+        /// @brief Number of images being loaded (counted into the queue depth).
+        int loadingCount = 0;
+        bool isStopping = false;
+        Exception error = Exception("");
+        bool isFailed = false;
+
+        Random rand;
+        PrefetchStats stats;
+        Mutex lockObj;
+        CondVar notEmpty;
+        CondVar notFull;
+
+        /// @brief I/O thread loop: picks a random image, loads it and puts it into the queue while the queue is not full.
+        /// @param prefetcher Prefetcher.
+        static void RunIOThread(ImagePrefetcher* prefetcher)
+        {
+            var& p = *prefetcher;
+
+            while (true)
+            {
+                p.lockObj.Lock();
+
+                var waitStart = Stopwatch::TotalNanoseconds();
+                while (!p.isStopping && p.queue.Count() + p.loadingCount >= p.depth)
+                    p.notFull.Wait(p.lockObj);
+                p.stats.IdleMs += (double)(Stopwatch::TotalNanoseconds() - waitStart) / 1e6;
+
+                if (p.isStopping)
+                {
+                    p.lockObj.Unlock();
+                    break;
+                }
+
+                var prefetched = PrefetchedImage();
+                prefetched.Index = Math::Min(p.rand.Next(0, p.loader->ImageCount()), p.loader->ImageCount() - 1);
+                p.loadingCount++;
+                p.lockObj.Unlock();
+
+                var loadStart = Stopwatch::TotalNanoseconds();
+                try
+                {
+                    prefetched.Image = p.loader->LoadImage(prefetched.Index);
+                }
+                catch (Exception& ex)
+                {
+                    p.lockObj.Lock();
+                    p.error = ex;
+                    p.isFailed = true;
+                    p.loadingCount--;
+                    p.notEmpty.WakeAll();
+                    p.lockObj.Unlock();
+                    break;
+                }
+                var loadMs = (double)(Stopwatch::TotalNanoseconds() - loadStart) / 1e6;
+
+                p.lockObj.Lock();
+                p.stats.LoadMs += loadMs;
+                p.loadingCount--;
+                p.queue.Enqueue(prefetched);
+                p.notEmpty.Wake();
+                p.lockObj.Unlock();
+            }
+        }
+
+    public:
+        /// @brief Creates a prefetcher and starts its I/O threads.
+        /// @param loader Image source (must outlive the prefetcher).
+        /// @param threadCount Number of I/O threads.
+        /// @param depth Max number of images loaded ahead (queued or being loaded).
+        ImagePrefetcher(ImageLoader* loader, int threadCount, int depth)
+        {
+            if (loader == null || loader->ImageCount() == 0)
+                throw ArgumentException((string)"The prefetcher requires a non-empty image source.");
+
+            if (threadCount <= 0 || depth < threadCount)
+                throw ArgumentException((string)"The prefetch thread count must be positive and the depth must not be smaller than the thread count.");
+
+            this->loader = loader;
+            this->depth = depth;
+
+            for (var i = 0; i < threadCount; i++)
+                threads.Add(Thread<ImagePrefetcher*>::Run(RunIOThread, this));
+        }
+
+        ~ImagePrefetcher()
+        {
+            lockObj.Lock();
+            isStopping = true;
+            notFull.WakeAll();
+            lockObj.Unlock();
+
+            ThreadBase::WaitAll(threads);
+        }
+
+        ImagePrefetcher(const ImagePrefetcher& other) = delete;
+
+        ImagePrefetcher& operator = (const ImagePrefetcher&) = delete;
+
+        /// @brief Takes the next loaded image from the queue (waits if the queue is empty).
+        /// @return Image and its index.
+        PrefetchedImage Next()
+        {
+            lockObj.Lock();
+
+            var waitStart = Stopwatch::TotalNanoseconds();
+            while (!isFailed && queue.Count() == 0)
+                notEmpty.Wait(lockObj);
+            stats.StallMs += (double)(Stopwatch::TotalNanoseconds() - waitStart) / 1e6;
+
+            if (isFailed)
+            {
+                var ex = error;
+                lockObj.Unlock();
+                throw ex;
+            }
+
+            var prefetched = queue.Dequeue();
+            stats.ImageCount++;
+            notFull.Wake();
+
+            lockObj.Unlock();
+            return prefetched;
+        }
+
+        /// @brief Gets prefetcher counters.
+        /// @return Prefetch statistics.
+        PrefetchStats Stats()
+        {
+            lockObj.Lock();
+            var s = stats;
+            lockObj.Unlock();
+            return s;
+        }
+
+        /// @brief Resets prefetcher counters.
+        void ResetStats()
+        {
+            lockObj.Lock();
+            stats = PrefetchStats();
+            lockObj.Unlock();
+        }
+    };
+}
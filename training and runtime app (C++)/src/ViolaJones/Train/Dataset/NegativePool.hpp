@@ -0,0 +1,125 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.Threading.h>
+#include "../../Shared/Cascade.hpp"
+#include "SampleStore.hpp"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+namespace ViolaJones
+{
+    using RescoreNegativesArgs = Tuple<SampleStore&, Cascade&, List<List<FeatureOffset>>&, List<float>&, List<bool>&>;
+
+    /// @brief Negatives (false positives) of the last stage carried over to the next stage. Each negative keeps the cascade confidence it was mined with,
+    ///        so only the trees added since are evaluated to find the negatives the extended cascade still accepts. Those are reused and only the shortfall is mined anew.
+    ///        Samples must be exact (see SampleStore::IsExact), so the pool keeps exactly the negatives the detector (and the mining) still accepts.
+    class NegativePool
+    {
+        SampleStore samples;
+        List<float> confidences;
+        int treeCount = 0;
+
+        /// @brief Continues a cascade evaluation of a pool sample with the trees added since the sample was mined (see EvalCascade).
+        /// @param samples Pool samples.
+        /// @param cascade Cascade to evaluate.
+        /// @param nodeOffsets Node pixel offsets of the added (last) trees.
+        /// @param sampleIdx Sample index.
+        /// @param confidence Confidence the sample was mined with - is updated by the added trees.
+        /// @return True if the sample is accepted (a false positive), false otherwise.
+        static bool RescoreSample(SampleStore& samples, Cascade& cascade, List<List<FeatureOffset>>& nodeOffsets, int sampleIdx, float& confidence)
+        {
+            var firstTreeIdx = (int)(cascade.Trees.Count() - nodeOffsets.Count());
+
+            for (var i = 0; i < nodeOffsets.Count(); i++)
+            {
+                var& tree = cascade.Trees[firstTreeIdx + i];
+                confidence += samples.EvalTree(tree, nodeOffsets[i], sampleIdx);
+
+                if (confidence < tree.Threshold)
+                    return false;
+            }
+
+            return true;
+        }
+
+    public:
+        /// @brief Gets the number of pooled negatives.
+        /// @return Negative count.
+        int Count()
+        {
+            return (int)samples.Count();
+        }
+
+        /// @brief Replaces the pool content by the negatives of a stage.
+        /// @param stageSamples Stage samples.
+        /// @param firstIdx Index of the first negative (negatives are stored after positives).
+        /// @param stageConfidences Cascade confidences of the negatives before the stage trees were added.
+        /// @param stageTreeCount Number of cascade trees before the stage trees were added.
+        void Set(SampleStore& stageSamples, int firstIdx, List<float>& stageConfidences, int stageTreeCount)
+        {
+            if (stageSamples.IsExact() == false)
+                throw ArgumentException((string)"Pooled negatives must reproduce the detector pixel reads (a 256 x 256 sample grid).");
+
+            samples = SampleStore(stageSamples.Rows, stageSamples.Cols, stageConfidences.Count());
+            for (var i = 0; i < stageConfidences.Count(); i++)
+                samples.Add(stageSamples, firstIdx + i);
+
+            confidences = stageConfidences;
+            treeCount = stageTreeCount;
+        }
+
+        /// @brief Re-scores all pooled negatives with the trees added since they were mined (in parallel if enabled) and moves the ones the cascade still accepts into a sample store.
+        ///        The pool is emptied.
+        /// @param cascade Cascade (the pooled negatives were mined with its first trees).
+        /// @param target Sample store the surviving negatives are added to. Negatives are added until the store is full at most.
+        /// @param pickCount Max number of negatives to add.
+        /// @return Cascade confidences of the added negatives (in the order of the added samples) and a survival rate (accepted / pooled negatives).
+        Tuple<List<float>, float> TakeSurvivors(Cascade& cascade, SampleStore& target, int pickCount)
+        {
+            if (treeCount > cascade.Trees.Count())
+                throw InvalidOperationException((string)"The negative pool was mined with a different cascade.");
+
+            var nodeOffsets = List<List<FeatureOffset>>();
+            for (var treeIdx = treeCount; treeIdx < cascade.Trees.Count(); treeIdx++)
+                nodeOffsets.Add(samples.GetFeatureOffsets(cascade.Trees[treeIdx].Nodes));
+
+            var results = List<bool>();
+            results.Add(false, samples.Count());
+
+#ifndef PARALLEL
+            for (var i = 0; i < samples.Count(); i++)
+                results[i] = RescoreSample(samples, cascade, nodeOffsets, i, confidences[i]);
+#else
+            var args = RescoreNegativesArgs(samples, cascade, nodeOffsets, confidences, results);
+            Parallel<RescoreNegativesArgs>::For(0, samples.Count(), [](RescoreNegativesArgs args, long i, bool& shouldCancel)
+            {
+                var& [samples, cascade, nodeOffsets, confidences, results] = args;
+                results[i] = RescoreSample(samples, cascade, nodeOffsets, i, confidences[i]);
+            },
+            args);
+#endif
+
+            var pickedConfs = List<float>();
+            var survivorCount = 0;
+            for (var i = 0; i < samples.Count(); i++)
+            {
+                if (!results[i])
+                    continue;
+
+                survivorCount++;
+                if (pickedConfs.Count() < pickCount && target.Add(samples, i) >= 0)
+                    pickedConfs.Add(confidences[i]);
+            }
+
+            var survivalRate = (samples.Count() > 0) ? (float)survivorCount / samples.Count() : 0.0f;
+
+            samples = SampleStore();
+            confidences.Clear();
+            return Tuple<List<float>, float>(pickedConfs, survivalRate);
+        }
+    };
+}
@@ -0,0 +1,426 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.IO.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include "Util.hpp"
+#include "DatasetManifest.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+
+namespace ViolaJones
+{
+    /// @brief Packed dataset file signature ('VJPK').
+    const Int32 PACKED_DATASET_MAGIC = 0x4B504A56;
+    /// @brief Packed dataset format version.
+    const Int32 PACKED_DATASET_VERSION = 2;
+
+    /// @brief Storage of packed images.
+    enum class PackedCompression
+    {
+        /// @brief Raw grayscale pixels (row major, no padding) - read without any decoding.
+        None = 0,
+        /// @brief Lossless PNG (grayscale) - smaller file, decoded on read.
+        Png = 1
+    };
+
+    /// @brief Read-only memory mapped file. The mapping is released when the object is destroyed.
+    class MappedFile
+    {
+        byte* data = null;
+        Int64 length = 0;
+
+#ifdef _WIN32
+        HANDLE fileHandle = INVALID_HANDLE_VALUE;
+        HANDLE mappingHandle = null;
+#endif
+
+    public:
+        /// @brief Maps the whole file into memory.
+        /// @param path File path.
+        MappedFile(const string& path)
+        {
+#ifdef _WIN32
+            fileHandle = CreateFileA(path.Ptr(), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, null);
+            if (fileHandle == INVALID_HANDLE_VALUE)
+                throw IOException("Can not open the specified file: " + path);
+
+            LARGE_INTEGER size;
+            GetFileSizeEx(fileHandle, &size);
+            length = size.QuadPart;
+
+            mappingHandle = CreateFileMappingA(fileHandle, null, PAGE_READONLY, 0, 0, null);
+            if (mappingHandle == null)
+                throw IOException("Can not map the specified file: " + path);
+
+            data = (byte*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+            if (data == null)
+                throw IOException("Can not map the specified file: " + path);
+#else
+            var fd = open(path.Ptr(), O_RDONLY);
+            if (fd < 0)
+                throw IOException("Can not open the specified file: " + path);
+
+            struct stat sb;
+            fstat(fd, &sb);
+            length = sb.st_size;
+
+            var ptr = mmap(null, length, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd); //the mapping keeps the file referenced
+
+            if (ptr == MAP_FAILED)
+                throw IOException("Can not map the specified file: " + path);
+
+            data = (byte*)ptr;
+            madvise(data, length, MADV_RANDOM); //images are accessed in a random order
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (data != null)
+                UnmapViewOfFile(data);
+            if (mappingHandle != null)
+                CloseHandle(mappingHandle);
+            if (fileHandle != INVALID_HANDLE_VALUE)
+                CloseHandle(fileHandle);
+#else
+            if (data != null)
+                munmap(data, length);
+#endif
+        }
+
+        MappedFile(const MappedFile& other) = delete;
+
+        MappedFile& operator = (const MappedFile&) = delete;
+
+        /// @brief Gets the first byte of the file.
+        /// @return Pointer to the mapped data.
+        const byte* Ptr()
+        {
+            return data;
+        }
+
+        /// @brief Gets the file size.
+        /// @return Number of bytes.
+        Int64 Length()
+        {
+            return length;
+        }
+    };
+
+    /// @brief Index entry of a packed image.
+    struct PackedImage
+    {
+        /// @brief Offset of the image data from the beginning of the file (64-byte aligned).
+        Int64 Offset;
+        /// @brief Size of the image data (raw pixels or the encoded image).
+        Int64 Size;
+        Int32 Rows;
+        Int32 Cols;
+    };
+
+    using CheckLabelStampsArgs = Tuple<const string&, List<string>&, List<Int64>&, List<bool>&>;
+
+    /// @brief Stamps of the database folder taken when it was packed, so a packed dataset which is older than the folder content is detected.
+    ///        Paths are relative to the database folder, hence the folder may be moved or referenced by another path.
+    struct PackedSource
+    {
+        /// @brief Number of images directly in the database folder (its stamp is not used - the apps write their outputs there).
+        Int32 RootImageCount = 0;
+        /// @brief Sub-folders containing images (relative).
+        List<string> Folders;
+        /// @brief Modification stamps of the sub-folders (a folder changes when a file is added, removed or renamed).
+        List<Int64> FolderStamps;
+        /// @brief Packed image files (relative).
+        List<string> ImageFiles;
+        /// @brief Modification stamps of the label files (-1 if an image has no label file).
+        List<Int64> LabelStamps;
+
+        /// @brief Gets a path relative to the database folder.
+        /// @param dbFolder Database folder.
+        /// @param path Path within the database folder.
+        /// @return Relative path (the path itself if it is not within the database folder).
+        static string GetRelativePath(const string& dbFolder, const string& path)
+        {
+            if (path.StartsWith(dbFolder) == false)
+                return path;
+
+            return path.Slice(dbFolder.Length()).TrimStart('/');
+        }
+
+        /// @brief Gets the folder of a relative file path.
+        /// @param relFile Relative file path.
+        /// @return Relative folder (empty for the database folder itself).
+        static string GetRelativeFolder(const string& relFile)
+        {
+            var slashIdx = relFile.Find('/', 0, true);
+            return (slashIdx > 0) ? relFile.Slice(0, slashIdx - 1) : string();
+        }
+
+        /// @brief Counts images directly in a folder.
+        /// @param folder Folder.
+        /// @return Image count.
+        static int CountImageFiles(const string& folder)
+        {
+            var count = 0;
+            for (var& file: Directory::GetFiles(folder, "", false))
+            {
+                if (IsImageFile(file))
+                    count++;
+            }
+
+            return count;
+        }
+
+        /// @brief Takes stamps of the folders of the provided images and of their label files.
+        /// @param dbFolder Database folder.
+        /// @param imageFiles Image files (as packed).
+        /// @return Packed source.
+        static PackedSource Create(const string& dbFolder, List<string>& imageFiles)
+        {
+            var source = PackedSource();
+            source.RootImageCount = CountImageFiles(dbFolder);
+
+            for (var& imFile: imageFiles)
+            {
+                var relFile = GetRelativePath(dbFolder, imFile);
+                source.ImageFiles.Add(relFile);
+                source.LabelStamps.Add(GetModificationStamp(GetLabelFile(imFile)));
+
+                var relFolder = GetRelativeFolder(relFile);
+                if (relFolder.Length() > 0 && source.Folders.Contains(relFolder) == false)
+                {
+                    source.Folders.Add(relFolder);
+                    source.FolderStamps.Add(GetModificationStamp(Path::Combine(dbFolder, relFolder)));
+                }
+            }
+
+            return source;
+        }
+
+        /// @brief Checks whether the database folder content changed since it was packed: an image count of the database folder, a sub-folder stamp or a label file stamp differs.
+        ///        If the images are not available anymore (only the packed file is kept), nothing is compared. Label files are checked in parallel (if enabled).
+        /// @param dbFolder Database folder.
+        /// @return True if the folder changed, false otherwise.
+        bool IsChanged(const string& dbFolder)
+        {
+            var rootImageCount = CountImageFiles(dbFolder);
+            var isSourceAvailable = rootImageCount > 0;
+            for (var& folder: Folders)
+                isSourceAvailable = isSourceAvailable || Directory::Exists(Path::Combine(dbFolder, folder));
+
+            if (!isSourceAvailable)
+                return false;
+
+            if (rootImageCount != RootImageCount)
+                return true;
+
+            for (var i = 0; i < Folders.Count(); i++)
+            {
+                if (GetModificationStamp(Path::Combine(dbFolder, Folders[i])) != FolderStamps[i])
+                    return true;
+            }
+
+#ifndef PARALLEL
+            for (var i = 0; i < ImageFiles.Count(); i++)
+            {
+                if (GetModificationStamp(GetLabelFile(Path::Combine(dbFolder, ImageFiles[i]))) != LabelStamps[i])
+                    return true;
+            }
+#else
+            //each label file is checked into its own result slot
+            var changes = List<bool>();
+            changes.Add(false, ImageFiles.Count());
+
+            var args = CheckLabelStampsArgs(dbFolder, ImageFiles, LabelStamps, changes);
+            Parallel<CheckLabelStampsArgs>::For(0, ImageFiles.Count(), [](CheckLabelStampsArgs args, long i, bool& shouldCancel)
+            {
+                var& [dbFolder, imageFiles, labelStamps, changes] = args;
+                changes[i] = GetModificationStamp(GetLabelFile(Path::Combine(dbFolder, imageFiles[i]))) != labelStamps[i];
+            },
+            args);
+
+            for (var isChanged: changes)
+            {
+                if (isChanged)
+                    return true;
+            }
+#endif
+
+            return false;
+        }
+    };
+
+    /// @brief Database folder packed into a single file: pre-decoded grayscale images (optionally downscaled and compressed) and their object ROIs.
+    ///        The file is memory mapped, so uncompressed images are read directly from the mapping without decoding.
+    ///        Layout: header (magic, version, compression), 64-byte aligned image data,
+    ///        index (image count, per image: offset, size, rows, cols, ROI count, ROIs - normalized YOLOv3 rectangles as labeled),
+    ///        source (see PackedSource: root image count, folder count, (folder, stamp) pairs, (image file, label stamp) pairs - one per image; strings are prefixed by their length)
+    ///        and the index offset (last 8 bytes).
+    class PackedDataset
+    {
+        SPtr<MappedFile> file;
+        PackedCompression compression = PackedCompression::None;
+        List<PackedImage> images;
+        List<List<Rect>> rois;
+        PackedSource source;
+
+        /// @brief Reads a value from the index and moves the position.
+        /// @param pos Current position (offset from the beginning of the file).
+        /// @return Value.
+        TC T ReadValue(Int64& pos)
+        {
+            if (pos + (Int64)sizeof(T) > file->Length())
+                throw IOException((string)"The packed dataset is corrupted (the index is out of the file bounds).");
+
+            T value;
+            memcpy(&value, file->Ptr() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        /// @brief Reads a string prefixed by its length from the index and moves the position.
+        /// @param pos Current position (offset from the beginning of the file).
+        /// @return String.
+        string ReadString(Int64& pos)
+        {
+            var length = ReadValue<Int32>(pos);
+            if (length < 0 || length > 4096 || pos + length > file->Length())
+                throw IOException((string)"The packed dataset is corrupted (invalid string in the index).");
+
+            char buff[4097] = { '\0' };
+            memcpy(buff, file->Ptr() + pos, length);
+            pos += length;
+            return string(buff);
+        }
+
+    public:
+        PackedDataset()
+        { }
+
+        /// @brief Opens (maps) a packed dataset and reads its index.
+        /// @param path Packed file path.
+        PackedDataset(const string& path)
+            :file(new MappedFile(path))
+        {
+            var pos = (Int64)0;
+            if (ReadValue<Int32>(pos) != PACKED_DATASET_MAGIC)
+                throw IOException("The specified file is not a packed dataset: " + path);
+
+            var version = ReadValue<Int32>(pos);
+            if (version != PACKED_DATASET_VERSION)
+                throw NotSupportedException("Unsupported packed dataset version: " + String(version) + " (" + path + ")");
+
+            compression = (PackedCompression)ReadValue<Int32>(pos);
+            if (compression != PackedCompression::None && compression != PackedCompression::Png)
+                throw NotSupportedException("Unsupported packed dataset compression: " + String((int)compression) + " (" + path + ")");
+
+            var indexPos = file->Length() - (Int64)sizeof(Int64);
+            pos = ReadValue<Int64>(indexPos);
+
+            var imageCount = ReadValue<Int32>(pos);
+            for (var i = 0; i < imageCount; i++)
+            {
+                var im = PackedImage();
+                im.Offset = ReadValue<Int64>(pos);
+                im.Size   = ReadValue<Int64>(pos);
+                im.Rows   = ReadValue<Int32>(pos);
+                im.Cols   = ReadValue<Int32>(pos);
+
+                if (im.Offset < 0 || im.Size < 0 || im.Offset + im.Size > file->Length())
+                    throw IOException("The packed dataset is corrupted (image data out of the file bounds): " + path);
+
+                //uncompressed images are read directly from the mapping (see GetImage)
+                if (im.Rows < 0 || im.Cols < 0 || (compression == PackedCompression::None && (Int64)im.Rows * im.Cols > im.Size))
+                    throw IOException("The packed dataset is corrupted (image size does not match its data): " + path);
+
+                var imRois = List<Rect>();
+                var roiCount = ReadValue<Int32>(pos);
+                for (var j = 0; j < roiCount; j++)
+                    imRois.Add(ReadValue<Rect>(pos));
+
+                images.Add(im);
+                rois.Add(imRois);
+            }
+
+            source.RootImageCount = ReadValue<Int32>(pos);
+            var folderCount = ReadValue<Int32>(pos);
+            for (var i = 0; i < folderCount; i++)
+            {
+                source.Folders.Add(ReadString(pos));
+                source.FolderStamps.Add(ReadValue<Int64>(pos));
+            }
+
+            for (var i = 0; i < imageCount; i++)
+            {
+                source.ImageFiles.Add(ReadString(pos));
+                source.LabelStamps.Add(ReadValue<Int64>(pos));
+            }
+        }
+
+        /// @brief Gets the number of images.
+        /// @return Image count.
+        int Count()
+        {
+            return images.Count();
+        }
+
+        /// @brief Checks whether the database folder the dataset was packed from changed since (see PackedSource::IsChanged).
+        /// @param dbFolder Database folder.
+        /// @return True if the packed dataset is older than the folder content, false otherwise.
+        bool IsSourceChanged(const string& dbFolder)
+        {
+            return source.IsChanged(dbFolder);
+        }
+
+        /// @brief Gets the image storage.
+        /// @return Compression.
+        PackedCompression Compression()
+        {
+            return compression;
+        }
+
+        /// @brief Gets object ROIs of an image as they were labeled (normalized).
+        /// @param imIdx Image index.
+        /// @return Object ROIs.
+        List<Rect>& GetObjects(int imIdx)
+        {
+            return rois[imIdx];
+        }
+
+        /// @brief Gets an uncompressed image. The image points to the mapped file (no copy) and must not be modified.
+        /// @param imIdx Image index.
+        /// @return Grayscale image.
+        cv::Mat GetImage(int imIdx)
+        {
+            var& im = images[imIdx];
+            return cv::Mat(im.Rows, im.Cols, CV_8UC1, (void*)(file->Ptr() + im.Offset));
+        }
+
+        /// @brief Decodes a compressed image.
+        /// @param imIdx Image index.
+        /// @return Grayscale image.
+        cv::Mat DecodeImage(int imIdx)
+        {
+            var& im = images[imIdx];
+            var encoded = cv::Mat(1, (int)im.Size, CV_8UC1, (void*)(file->Ptr() + im.Offset));
+            return cv::imdecode(encoded, cv::IMREAD_GRAYSCALE);
+        }
+    };
+}
@@ -3,6 +3,7 @@
 #include <System.h>
 #include "../../Test/Test.hpp"
 #include "Dataset.hpp"
+#include "SampleStore.hpp"
 
 using namespace System;
 using namespace System::Collections::Generic;
@@ -10,137 +11,155 @@ using namespace System::Threading;
 
 namespace ViolaJones
 {
-    using SamplePositivesResult = Tuple<List<cv::Mat>&, List<float>&, int&, Mutex&>;
-    using SamplePositivesTerm = Tuple<int, float>;
-    using SamplePositivesArgs = Tuple<Cascade&, LabeledDataset&, SamplePositivesTerm, SamplePositivesResult>;
+    using GetPatchesArgs = Tuple<LabeledDataset&, int, List<cv::Mat>&>;
+
+    /// @brief Gets a batch of dataset patches (in parallel if enabled - images are read and decoded concurrently).
+    /// @param patches Dataset.
+    /// @param start Index of the first patch.
+    /// @param count Number of patches.
+    /// @return Grayscale patches.
+    static List<cv::Mat> GetPatches(LabeledDataset& patches, int start, int count)
+    {
+        var batch = List<cv::Mat>();
+        batch.Add(cv::Mat(), count);
+
+#ifndef PARALLEL
+        for (var i = 0; i < count; i++)
+            batch[i] = patches[start + i];
+#else
+        var args = GetPatchesArgs(patches, start, batch);
+        Parallel<GetPatchesArgs>::For(0, count, [](GetPatchesArgs args, long i, bool& shouldCancel)
+        {
+            var& [patches, start, batch] = args;
+            batch[i] = patches[start + i];
+        },
+        args);
+#endif
+
+        return batch;
+    }
 
     /// @brief Takes samples from a provided dataset, classifies them and takes only positive ones.
+    ///        Patches are read and classified in batches (see GetPatches and ClassifyPatches) and the positive ones are added in the patch order, so no locking is needed.
     /// @param cascade Cascade to evaluate.
     /// @param patches Dataset.
+    /// @param samples Sample store where the picked samples are added (resampled). Samples are picked until the store is full at most.
     /// @param pickCount Max number of positive samples to pick.
-    /// @param minHitRate Min hit rate to achieve while sampling.
-    /// @return Collection of samples, classifier confidences and a hit rate (TPR or FPR depending on a dataset).
-    static Tuple<List<cv::Mat>, List<float>, float> SamplePositivesSequential(Cascade& cascade, LabeledDataset& patches, int pickCount, float minHitRate)
+    /// @param minHitRate Min hit rate to achieve while sampling (checked after each pickCount trials).
+    /// @param minTrialCount Min number of trials between hit rate checks (pickCount if larger), so a small pickCount does not stop the sampling on a few trials.
+    /// @return Classifier confidences of the picked samples (in the order of the added samples) and a hit rate (TPR or FPR depending on a dataset).
+    Tuple<List<float>, float> SamplePositives(Cascade& cascade, LabeledDataset& patches, SampleStore& samples, int pickCount, float minHitRate = 0.0f, int minTrialCount = 0)
     {
-        List<cv::Mat> positiveSamples;
-        List<float> confidences;
-        float hitRate;
+        var confidences = List<float>();
+        var nTrials = 0;
+        var isTooHard = false;
+        var checkInterval = Math::Max(pickCount, minTrialCount);
 
-        var i = 0, nPicked = 0;
-        while (nPicked < pickCount && i < patches.Count())
+        while (!isTooHard && confidences.Count() < pickCount && samples.Count() < samples.Capacity() && nTrials < patches.Count())
         {
-            //classify patch and store a result in a list
-            var patch = patches[i];
-            var conf = 0.0f;
-            var result = ClassifyPatch(cascade, patch, conf);
+            var batchSize = (int)Math::Min((long)SAMPLING_BATCH_SIZE, patches.Count() - nTrials);
+            var batch = GetPatches(patches, nTrials, batchSize);
+
+            var batchConfs = List<float>();
+            var results = ClassifyPatches(cascade, batch, batchConfs);
 
-            if (result)
+            for (var i = 0; i < batchSize && confidences.Count() < pickCount; i++)
             {
-                positiveSamples.Add(patch);
-                confidences.Add(conf);
-                nPicked += 1;
-            }
+                if (results[i] && samples.Add(batch[i]) >= 0)
+                    confidences.Add(batchConfs[i]);
 
-            i += 1;
+                nTrials++;
 
-            //break loop if too hard
-            if (i % pickCount == 0)
-            {
-                hitRate = (float)nPicked / i;
-                if (hitRate < minHitRate)
+                //break loop if too hard
+                if (nTrials % checkInterval == 0 && (float)confidences.Count() / nTrials < minHitRate)
+                {
+                    isTooHard = true;
                     break;
+                }
             }
 
-            Console::Write((string)"\r\tSampling: " + nPicked + " / " + pickCount);
+            Console::Write((string)"\r\tSampling: " + (int)confidences.Count() + " / " + pickCount);
         }
 
         Console::WriteLine();
-        hitRate = (float)nPicked / i;
-
-        return Tuple<List<cv::Mat>, List<float>, float>(positiveSamples, confidences, hitRate);
+        var hitRate = (float)confidences.Count() / nTrials;
+        return Tuple<List<float>, float>(confidences, hitRate);
     }
 
-
-    /// @brief Takes only positive samples from a dataset. Used in parallel sample retrieval.
-    /// @param args Action arguments.
-    /// @param index Index for a dataset.
-    /// @param shouldCancel Cancellation token.
-    static void SamplePositiveParallelAction(SamplePositivesArgs args, long index, bool& shouldCancel)
+    /// @brief Mines false positives by scanning whole negative images with the detector (see DetectObjects): every window of every scale is evaluated, 
+    ///        and the accepted windows which do not overlap labeled objects (IOU < NEGATIVE_MAX_IOU) are false positive candidates.
+    ///        A decoded image thus yields thousands of evaluated windows. At most DENSE_MINING_MAX_PER_IMAGE random candidates are taken from a single image.
+    /// @param cascade Cascade to evaluate.
+    /// @param negatives Negative dataset (images and their labeled objects).
+    /// @param samples Sample store where the picked samples are added (resampled). Samples are picked until the store is full at most.
+    /// @param pickCount Max number of false positives to pick.
+    /// @param minHitRate Min hit rate (false positive windows / evaluated windows) to achieve while sampling (checked after at least pickCount windows).
+    /// @param minTrialCount Min number of evaluated windows before the hit rate is checked (pickCount if larger).
+    /// @return Classifier confidences of the picked samples (in the order of the added samples) and a hit rate (window FPR).
+    Tuple<List<float>, float> SampleFalsePositivesDense(Cascade& cascade, NegativeDataset& negatives, SampleStore& samples, int pickCount, float minHitRate = 0.0f, int minTrialCount = 0)
     {
-        var& [cascade, patches, termData, resultData] = args;
-        var& [pickCount, minHitRate] = termData;
-        var& [positiveSamples, confidences, i, lockObj] = resultData;
+        var confidences = List<float>();
+        var imageCount = 0l, windowCount = 0l, fpCount = 0l;
+        var rand = Random();
+
+        var options = DetectionOptions();
+        options.MaxDetections = 0; //all windows are scanned
 
-        //termination condition check
-        lockObj.Lock();
+        while (confidences.Count() < pickCount && samples.Count() < samples.Capacity() && negatives.ImageCount() > 0)
         {
-            if (i >= patches.Count())
-                shouldCancel = true;
+            var [imIdx, image] = negatives.NextImage();
+            var& objects = negatives.GetObjects(imIdx);
 
-            if (positiveSamples.Count() >= pickCount)
-                shouldCancel = true;
+            var imWindowCount = 0l;
+            var detections = DetectObjects(cascade, image, imWindowCount, options);
+            imageCount++;
+            windowCount += imWindowCount;
 
-            //break if too hard
-            if (i % pickCount == 0 && i > 0)
+            //windows overlapping or containing labeled objects are not negatives
+            var candidates = List<Detection>();
+            for (var& d: detections)
             {
-                var hitRate = (float)positiveSamples.Count() / i;
-                if (hitRate < minHitRate)
-                    shouldCancel = true;
+                var ww = (float)Math::Floor(d.Scale * cascade.WidthHeightRatio);
+                var roi = Rect 
+                { 
+                    .CenterX = (d.Col + ww / 2) / image.cols, 
+                    .CenterY = (d.Row + d.Scale / 2) / image.rows, 
+                    .Width   = ww / image.cols, 
+                    .Height  = d.Scale / image.rows 
+                };
+
+                if (negatives.GetMaxIOU(roi, objects) < DENSE_MINING_MAX_IOU && negatives.GetMaxObjectCoverage(roi, objects) < DENSE_MINING_MAX_OBJECT_COVERAGE)
+                    candidates.Add(d);
             }
-        }
-        lockObj.Unlock();
-        if (shouldCancel || (index >= patches.Count())) 
-            return;
 
-        //evaluate patch
-        var patch = patches[index];
-        var conf = 0.0f;
-        var result = ClassifyPatch(cascade, patch, conf);
+            fpCount += candidates.Count();
 
-        //update collections and counter
-        lockObj.Lock();
-        {
-            if (result)
+            //take a random subset of candidates (partial Fisher-Yates shuffle)
+            var takeCount = (int)Math::Min(Math::Min(candidates.Count(), (long)DENSE_MINING_MAX_PER_IMAGE), pickCount - confidences.Count());
+            for (var i = 0; i < takeCount; i++)
             {
-                positiveSamples.Add(patch);
-                confidences.Add(conf);
+                var j = Math::Min(rand.Next(i, candidates.Count()), (int)candidates.Count() - 1);
+                var tmp = candidates[i]; candidates[i] = candidates[j]; candidates[j] = tmp;
+
+                var& d = candidates[i];
+                var patch = cv::Mat(image, cv::Rect(d.Col, d.Row, Math::Floor(d.Scale * cascade.WidthHeightRatio), d.Scale));
+                if (samples.Add(patch) < 0)
+                    break;
+
+                confidences.Add(d.Confidence);
             }
 
-            i += 1;
-            Console::Write((string)"\r\tSampling: " + positiveSamples.Count());
+            Console::Write((string)"\r\tSampling: " + (int)confidences.Count() + " / " + pickCount + " (images: " + imageCount + ", windows: " + windowCount + ")");
+
+            //break loop if too hard
+            if (windowCount >= Math::Max(pickCount, minTrialCount) && (float)fpCount / windowCount < minHitRate)
+                break;
         }
-        lockObj.Unlock();
-    }
 
-    /// @brief Takes samples from a provided dataset, classifies them and takes only positive ones. Does this in parallel if parallelism enabled.
-    /// @param cascade Cascade to evaluate.
-    /// @param patches Dataset.
-    /// @param pickCount Max number of positive samples to pick.
-    /// @param minHitRate Min hit rate to achieve while sampling.
-    /// @return Collection of samples, classifier confidences and a hit rate (TPR or FPR depending on a dataset).
-    Tuple<List<cv::Mat>, List<float>, float> SamplePositives(Cascade& cascade, LabeledDataset& patches, int pickCount, float minHitRate = 0.0f)
-    {
-#ifndef PARALLEL
-        return SamplePositivesSequential(cascade, patches, pickCount, minHitRate);
-#else
-        List<cv::Mat> positiveSamples;
-        List<float> confidences;
-        int nTrials = 0;
-        Mutex lockObj;
-
-        //thread arguments
-        var result = SamplePositivesResult(positiveSamples, confidences, nTrials, lockObj);
-        var term = SamplePositivesTerm(pickCount, minHitRate);
-        var args = SamplePositivesArgs(cascade, patches, term, result);
-
-        //run an infinite for loop, cancelled only by a provided token
-        var sliceSize = (int)Math::Max(pickCount / Environment::ProcessorCount(), 1);
-        Parallel<SamplePositivesArgs>::InfiniteFor(0, SamplePositiveParallelAction, args, sliceSize);
-        Console::WriteLine(); 
-
-        //return results
-        var hitRate = (float)positiveSamples.Count() / nTrials;
-        return Tuple<List<cv::Mat>, List<float>, float>(positiveSamples, confidences, hitRate);
-#endif
+        Console::WriteLine();
+        Console::WriteLine((string)"\tDense mining - images: " + imageCount + ", windows/image: " + String((double)windowCount / Math::Max(1l, imageCount), 0));
+
+        var hitRate = (windowCount > 0) ? (float)fpCount / windowCount : 0.0f;
+        return Tuple<List<float>, float>(confidences, hitRate);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <System.h>
+#include <System.Collections.h>
+#include <System.Threading.h>
+#include <opencv2/core.hpp>
+#include "../../Shared/Cascade.hpp"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+namespace ViolaJones
+{
+    /// @brief Pixel offsets (within a sample) of both pixels compared by a feature.
+    struct FeatureOffset
+    {
+        int A;
+        int B;
+    };
+
+    /// @brief Training samples (patches) resampled to a fixed canonical grid and kept in a single contiguous byte buffer.
+    ///        Each sample occupies a fixed, 64-byte aligned slot, so a feature evaluation is a comparison of two indexed loads.
+    class SampleStore
+    {
+        /// @brief Sample buffer (with a padding for the alignment).
+        List<byte> data;
+        int stride = 0;
+        int capacity = 0;
+        int count = 0;
+
+        /// @brief Gets the (aligned) first byte of the sample buffer.
+        /// @return Pointer to the first sample.
+        byte* Base()
+        {
+            var ptr = data.begin();
+            return ptr + (64 - (size_t)ptr % 64) % 64;
+        }
+
+        /// @brief Maps a normalized feature coordinate [-128..127] to a pixel index the same way as EvalFeature does.
+        /// @param coord Normalized coordinate.
+        /// @param size Patch size (rows or columns).
+        /// @return Pixel index.
+        static int MapCoordinate(int coord, int size)
+        {
+            return Math::Max(0, Math::Min(((size / 2) * 256 + coord * size) / 256, size - 1));
+        }
+
+        /// @brief For each grid index gets the normalized coordinate in the middle of all coordinates mapped to the index.
+        /// @param size Grid size (rows or columns).
+        /// @return Normalized coordinates.
+        static List<int> GridCoordinates(int size)
+        {
+            var minCoords = List<int>(), maxCoords = List<int>();
+            minCoords.Add(+128, size);
+            maxCoords.Add(-129, size);
+
+            for (var coord = -128; coord <= 127; coord++)
+            {
+                var idx = MapCoordinate(coord, size);
+                minCoords[idx] = Math::Min(minCoords[idx], coord);
+                maxCoords[idx] = Math::Max(maxCoords[idx], coord);
+            }
+
+            var coords = List<int>();
+            for (var i = 0; i < size; i++)
+                coords.Add((minCoords[i] + maxCoords[i]) / 2);
+
+            return coords;
+        }
+
+        List<int> gridRowCoords;
+        List<int> gridColCoords;
+
+    public:
+        /// @brief Canonical sample height.
+        int Rows = 0;
+        /// @brief Canonical sample width.
+        int Cols = 0;
+
+        SampleStore()
+        { }
+
+        /// @brief Gets the canonical sample width for a sample height.
+        ///        A 256 x 256 grid has a cell for each normalized feature coordinate, so it reproduces the detector pixel reads exactly for any patch size;
+        ///        the full height therefore also gets the full width, smaller grids follow the width height ratio.
+        /// @param rows Canonical sample height.
+        /// @param whRatio Width height ratio.
+        /// @return Canonical sample width.
+        static int GridCols(int rows, float whRatio)
+        {
+            if (rows == 256)
+                return 256;
+
+            return Math::Max(1, Math::Min((int)Math::Round(rows * whRatio), 256));
+        }
+
+        /// @brief Creates a new sample store.
+        /// @param rows Canonical sample height.
+        /// @param cols Canonical sample width.
+        /// @param capacity Max number of samples.
+        SampleStore(int rows, int cols, int capacity)
+        {
+            if (rows < 1 || rows > 256 || cols < 1 || cols > 256 || capacity < 0)
+                throw ArgumentException((string)"The sample size must be in range [1..256] and the capacity must not be negative.");
+
+            this->Rows = rows;
+            this->Cols = cols;
+            this->capacity = capacity;
+            this->stride = (rows * cols + 63) / 64 * 64;
+
+            data.Add(0, capacity * stride + 64);
+            gridRowCoords = GridCoordinates(rows);
+            gridColCoords = GridCoordinates(cols);
+        }
+
+        /// @brief Checks whether samples reproduce the detector pixel reads exactly (256 x 256 grid, see GridCols).
+        ///        Only then a cascade evaluated on the samples gives the same confidences as the detector on the patches.
+        /// @return True if the grid is exact, false otherwise.
+        bool IsExact()
+        {
+            return Rows == 256 && Cols == 256;
+        }
+
+        /// @brief Gets the number of samples.
+        /// @return Sample count.
+        long Count()
+        {
+            return count;
+        }
+
+        /// @brief Gets the max number of samples.
+        /// @return Capacity.
+        int Capacity()
+        {
+            return capacity;
+        }
+
+        /// @brief Gets memory occupied by samples (buffer size).
+        /// @return Number of bytes.
+        long MemorySize()
+        {
+            return data.Count();
+        }
+
+        /// @brief Reserves a slot for a new sample. Samples may be written in parallel into reserved slots (see Set).
+        /// @return Sample index or -1 if the store is full.
+        int Reserve()
+        {
+            if (count >= capacity)
+                return -1;
+
+            return count++;
+        }
+
+        /// @brief Resamples a patch to the canonical grid and writes it into a reserved slot.
+        ///        Each grid pixel is taken from the patch pixel which EvalFeature reads for the grid pixel coordinates, hence features read (nearly) the same pixels as at runtime.
+        /// @param sampleIdx Reserved sample index.
+        /// @param patch Grayscale patch.
+        void Set(int sampleIdx, cv::Mat& patch)
+        {
+            var dst = Sample(sampleIdx);
+
+            for (var r = 0; r < Rows; r++)
+            {
+                var srcRow = patch.ptr<byte>(MapCoordinate(gridRowCoords[r], patch.rows));
+
+                for (var c = 0; c < Cols; c++)
+                    dst[r * Cols + c] = srcRow[MapCoordinate(gridColCoords[c], patch.cols)];
+            }
+        }
+
+        /// @brief Adds a patch (resampled to the canonical grid).
+        /// @param patch Grayscale patch.
+        /// @return Sample index or -1 if the store is full.
+        int Add(cv::Mat& patch)
+        {
+            var sampleIdx = Reserve();
+            if (sampleIdx >= 0)
+                Set(sampleIdx, patch);
+
+            return sampleIdx;
+        }
+
+        /// @brief Adds a copy of a sample of another store with the same canonical grid.
+        /// @param source Source sample store.
+        /// @param sampleIdx Source sample index.
+        /// @return Sample index or -1 if the store is full.
+        int Add(SampleStore& source, int sampleIdx)
+        {
+            if (source.Rows != Rows || source.Cols != Cols)
+                throw ArgumentException((string)"Samples can be copied only between stores with the same canonical grid.");
+
+            var dstIdx = Reserve();
+            if (dstIdx >= 0)
+                memcpy(Sample(dstIdx), source.Sample(sampleIdx), Rows * Cols);
+
+            return dstIdx;
+        }
+
+        /// @brief Gets sample pixels (row major, Rows x Cols).
+        /// @param sampleIdx Sample index.
+        /// @return Pointer to the first sample pixel.
+        byte* Sample(int sampleIdx)
+        {
+            return Base() + (long)sampleIdx * stride;
+        }
+
+        /// @brief Gets sample pixel offsets of a feature (computed once per feature).
+        /// @param feature Feature (node).
+        /// @return Pixel offsets.
+        FeatureOffset GetFeatureOffset(Node& feature)
+        {
+            var offset = FeatureOffset();
+            offset.A = MapCoordinate(feature.RowA, Rows) * Cols + MapCoordinate(feature.ColA, Cols);
+            offset.B = MapCoordinate(feature.RowB, Rows) * Cols + MapCoordinate(feature.ColB, Cols);
+            return offset;
+        }
+
+        /// @brief Gets sample pixel offsets of features.
+        /// @param features Features (nodes).
+        /// @return Pixel offsets.
+        List<FeatureOffset> GetFeatureOffsets(List<Node>& features)
+        {
+            var offsets = List<FeatureOffset>();
+            for (var& f: features)
+                offsets.Add(GetFeatureOffset(f));
+
+            return offsets;
+        }
+
+        /// @brief Evaluates a feature on a sample.
+        /// @param offset Feature pixel offsets.
+        /// @param sampleIdx Sample index.
+        /// @return True if a value of the first pixel is smaller or equal to the second one (see EvalFeature).
+        bool EvalFeature(const FeatureOffset& offset, int sampleIdx)
+        {
+            var sample = Sample(sampleIdx);
+            return sample[offset.A] <= sample[offset.B];
+        }
+
+        /// @brief Evaluates a tree on a sample.
+        /// @param tree Tree to evaluate.
+        /// @param nodeOffsets Pixel offsets of the tree nodes (see GetFeatureOffsets).
+        /// @param sampleIdx Sample index.
+        /// @return Leaf value.
+        float EvalTree(Tree& tree, List<FeatureOffset>& nodeOffsets, int sampleIdx)
+        {
+            var treeDepth = int(Math::Log2(tree.Nodes.Count() + 1));
+
+            var nodeIdx = 0;
+            for (var depth = 0; depth < treeDepth; depth++)
+            {
+                var isTrue = EvalFeature(nodeOffsets[nodeIdx], sampleIdx);
+                nodeIdx = isTrue ? nodeIdx * 2 + 2 : nodeIdx * 2 + 1;
+            }
+
+            var leafIdx = nodeIdx - (Math::Pow(2, treeDepth) - 1);
+            return tree.Leafs[leafIdx];
+        }
+
+        /// @brief Evaluates a tree on a sample.
+        /// @param tree Tree to evaluate.
+        /// @param sampleIdx Sample index.
+        /// @return Leaf value.
+        float EvalTree(Tree& tree, int sampleIdx)
+        {
+            var nodeOffsets = GetFeatureOffsets(tree.Nodes);
+            return EvalTree(tree, nodeOffsets, sampleIdx);
+        }
+    };
+
+    using EvalTreeBatchArgs = Tuple<SampleStore&, Tree&, List<FeatureOffset>&, List<float>&>;
+
+    /// @brief Evaluates a tree on all samples of a store (in parallel if enabled). Node pixel offsets are computed once for all samples.
+    /// @param samples Sample store.
+    /// @param tree Tree to evaluate.
+    /// @return Tree outputs (leaf values) in the sample order.
+    static List<float> EvalTreeBatch(SampleStore& samples, Tree& tree)
+    {
+        var nodeOffsets = samples.GetFeatureOffsets(tree.Nodes);
+        var outputs = List<float>();
+        outputs.Add(0.0f, samples.Count());
+
+#ifndef PARALLEL
+        for (var i = 0; i < samples.Count(); i++)
+            outputs[i] = samples.EvalTree(tree, nodeOffsets, i);
+#else
+        var args = EvalTreeBatchArgs(samples, tree, nodeOffsets, outputs);
+        Parallel<EvalTreeBatchArgs>::For(0, samples.Count(), [](EvalTreeBatchArgs args, long sampleIdx, bool& shouldCancel)
+        {
+            var& [samples, tree, nodeOffsets, outputs] = args;
+            outputs[sampleIdx] = samples.EvalTree(tree, nodeOffsets, sampleIdx);
+        },
+        args);
+#endif
+
+        return outputs;
+    }
+}
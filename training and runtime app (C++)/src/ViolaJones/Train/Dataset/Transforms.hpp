@@ -16,6 +16,11 @@ namespace ViolaJones
             /// @param source Source ROI.
             /// @return Modified ROI.
             virtual Rect Transform(const Rect& source) = 0;
+
+            /// @brief Gets a ROI which contains every ROI the transform can produce from the provided ROI.
+            /// @param source Source ROI.
+            /// @return Bounding ROI (not clipped).
+            virtual Rect MaxBounds(const Rect& source) = 0;
     };
 
     /// @brief ROI transform that jitters ROI center coordinate and its size.
@@ -51,6 +56,23 @@ namespace ViolaJones
                 return rect;
             }
 
+            /// @brief Gets a ROI which contains every jittered ROI: the largest scale plus the largest offset to both sides.
+            /// @param source Source ROI.
+            /// @return Bounding ROI (not clipped).
+            Rect MaxBounds(const Rect& source) override
+            {
+                var [xC, yC, w, h] = source;
+                var maxScale = 1 + whScalePerc;
+
+                return Rect 
+                { 
+                    .CenterX = xC, 
+                    .CenterY = yC, 
+                    .Width   = w * maxScale + 2 * w * wTranslatePerc, 
+                    .Height  = h * maxScale + 2 * h * hTranslatePerc 
+                };
+            }
+
         private:
             float wTranslatePerc; 
             float hTranslatePerc; 
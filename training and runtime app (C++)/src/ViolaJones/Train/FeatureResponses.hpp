@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../Shared/Cascade.hpp"
+#include "Dataset/SampleStore.hpp"
+
+namespace ViolaJones
+{
+    /// @brief Bit-packed responses of candidate features over samples.
+    ///        Each feature has a row of 64-bit words where bit i is set if the feature (pixel comparison) is true for sample i.
+    struct FeatureResponses
+    {
+        int FeatureCount = 0;
+        int SampleCount = 0;
+        /// @brief Number of 64-bit words per feature row.
+        int WordCount = 0;
+        List<UInt64> Bits;
+
+        FeatureResponses()
+        { }
+
+        /// @brief Creates responses (all false) for the specified number of features and samples.
+        /// @param featureCount Number of features.
+        /// @param sampleCount Number of samples.
+        FeatureResponses(int featureCount, int sampleCount)
+        {
+            FeatureCount = featureCount;
+            SampleCount = sampleCount;
+            WordCount = (sampleCount + 63) / 64;
+            Bits.Add(0, featureCount * WordCount);
+        }
+
+        /// @brief Gets responses of a feature.
+        /// @param featureIdx Feature index.
+        /// @return Pointer to the first word of the feature row.
+        UInt64* Row(int featureIdx)
+        {
+            return Bits.begin() + (long)featureIdx * WordCount;
+        }
+
+        /// @brief Gets a response of a feature for a sample.
+        /// @param featureIdx Feature index.
+        /// @param sampleIdx Sample index.
+        /// @return True if the feature is true for the sample.
+        bool Get(int featureIdx, int sampleIdx)
+        {
+            return (Row(featureIdx)[sampleIdx / 64] >> (sampleIdx % 64)) & 1;
+        }
+    };
+
+    /// @brief Random features drawn once per stage and their responses over all stage samples (bit i corresponds to sample i of the store).
+    ///        Nodes of all trees of the stage pick their candidates from the pool, so no feature is evaluated on pixels more than once per stage.
+    struct FeaturePool
+    {
+        List<Node> Features;
+        FeatureResponses Responses;
+    };
+
+    using FeatureResponsesArgs = Tuple<List<FeatureOffset>&, SampleStore&, List<int>&, int, FeatureResponses&>;
+
+    /// @brief Evaluates all features on a block of (up to) 64 samples and packs the responses into a single word of each feature row.
+    ///        Samples of a block stay in cache while all features are evaluated.
+    /// @param offsets Feature pixel offsets.
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (in the store).
+    /// @param start Index of the first evaluated sample index.
+    /// @param responses Feature responses.
+    /// @param wordIdx Word (sample block) index.
+    static void EvalFeatureWord(List<FeatureOffset>& offsets, SampleStore& samples, List<int>& sampleIndices, int start, FeatureResponses& responses, int wordIdx)
+    {
+        var firstSample = wordIdx * 64;
+        var bitCount = Math::Min(64, responses.SampleCount - firstSample);
+
+        const byte* blockSamples[64];
+        for (var b = 0; b < bitCount; b++)
+            blockSamples[b] = samples.Sample(sampleIndices[start + firstSample + b]);
+
+        for (var featureIdx = 0; featureIdx < offsets.Count(); featureIdx++)
+        {
+            var offset = offsets[featureIdx];
+            var word = (UInt64)0;
+
+            for (var b = 0; b < bitCount; b++)
+                word |= (UInt64)(blockSamples[b][offset.A] <= blockSamples[b][offset.B]) << b;
+
+            responses.Row(featureIdx)[wordIdx] = word;
+        }
+    }
+
+    /// @brief Evaluates all features on all samples (in parallel over sample blocks if enabled).
+    /// @param features Feature (node) collection.
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (in the store).
+    /// @param start Index of the first evaluated sample index.
+    /// @param count Number of evaluated samples.
+    /// @return Bit-packed feature responses (bit i corresponds to sampleIndices[start + i]).
+    static FeatureResponses CalculateFeatureResponses(List<Node>& features, SampleStore& samples, List<int>& sampleIndices, int start, int count)
+    {
+        var offsets = samples.GetFeatureOffsets(features);
+
+        var responses = FeatureResponses(features.Count(), count);
+
+#ifndef PARALLEL
+        for (var wordIdx = 0; wordIdx < responses.WordCount; wordIdx++)
+            EvalFeatureWord(offsets, samples, sampleIndices, start, responses, wordIdx);
+#else
+        var args = FeatureResponsesArgs(offsets, samples, sampleIndices, start, responses);
+        Parallel<FeatureResponsesArgs>::For(0, responses.WordCount, [](FeatureResponsesArgs args, long wordIdx, bool& shouldCancel)
+        {
+            var& [offsets, samples, sampleIndices, start, responses] = args;
+            EvalFeatureWord(offsets, samples, sampleIndices, start, responses, wordIdx);
+        },
+        args);
+#endif
+
+        return responses;
+    }
+}
@@ -1,6 +1,7 @@
 #define PARALLEL 1 //execute training procedure in parallel where applicable
 
 #include "Train.hpp"
+#include "Benchmark.hpp"
 #include <Extensions/ConsoleExtensions.h>
 
 using namespace System;
@@ -14,12 +15,96 @@ static void OutputThreadError(Exception& ex)
     Console::Error(ex);
 }
 
+/// @brief Runs a training benchmark: boosts first stage trees with the exhaustive, the successive halving and the feature pool search and compares their time and quality.
+///        Args: bench <database path> [tree count = 8]
+/// @param args Console args (the first one is 'bench').
+static void RunBenchmark(List<string>& args)
+{
+    if (args.Count() < 2 || args.Count() > 3)
+        throw NotSupportedException((string)"Invalid number of benchmark arguments.");
+
+    var dbPath    = args[1];
+    var treeCount = (args.Count() > 2) ? String::ParseInt32(args[2]) : BENCHMARK_TREE_COUNT;
+    if (treeCount <= 0)
+        throw ArgumentException((string)"Invalid number of benchmark trees.");
+
+    //config (if exists, otherwise defaults) and an empty cascade - the benchmark does not write anything
+    var configFile = Path::Combine(dbPath, (string)"trainConfig.txt");
+    bool isConfigCreated;
+    var config = File::Exists(configFile) ? TrainConfig::LoadOrCreate(dbPath, isConfigCreated) : TrainConfig();
+
+    var cascade = Cascade();
+    cascade.TreeDepth = config.MaxTreeDepth;
+    cascade.WidthHeightRatio = config.WidthHeightRatio;
+
+    Console::WriteLine((string)"Dataset:");
+    var transform = RoiRandomJitterTransform();
+    var baseSet   = LabeledDataset(dbPath, cascade.WidthHeightRatio, config.ImageCacheMB);
+
+    //objects of held-out images are used for validation only
+    var trainImages = List<int>(), valImages = List<int>();
+    SplitBenchmarkImages(baseSet, trainImages, valImages);
+
+    var posSet    = PositiveDataset(baseSet, trainImages, &transform);
+    var valPosSet = PositiveDataset(baseSet, valImages, &transform);
+    if (config.PositiveCropSize > 0)
+    {
+        var cropObjectSize = (config.SampleSize == 256) ? 0 : config.PositiveCropSize; //the exact grid reads the original pixels
+        posSet.CacheCrops(cropObjectSize);
+        valPosSet.CacheCrops(cropObjectSize);
+    }
+    var negSet = NegativeDataset(baseSet);
+
+    if (posSet.Count() == 0 || valPosSet.Count() == 0)
+        throw ArgumentException((string)"The database does not contain enough images with objects (at least " + BENCHMARK_VALIDATION_IMAGE_STEP + "): " + dbPath);
+
+    //negatives are random patches sampled independently for each set
+    var samples = SampleStore(), valSamples = SampleStore();
+    var labels    = SampleBenchmarkData(cascade, posSet,    negSet, config.SampleSize, samples);
+    var valLabels = SampleBenchmarkData(cascade, valPosSet, negSet, config.SampleSize, valSamples);
+    Console::WriteLine((string)"Samples: " + (int)samples.Count() + ", validation samples: " + (int)valSamples.Count() + " (" + (int)valImages.Count() + " held-out images), trees: " + treeCount + ", tree depth: " + cascade.TreeDepth);
+
+    var searches = List<FeatureSearchOptions>();
+    var exhaustive = FeatureSearchOptions();
+    searches.Add(exhaustive);
+
+    for (var featureCount: { RANDOM_FEATURE_COUNT, 4 * RANDOM_FEATURE_COUNT, 8 * RANDOM_FEATURE_COUNT, 16 * RANDOM_FEATURE_COUNT })
+    {
+        var halving = FeatureSearchOptions();
+        halving.FeatureCount = featureCount;
+        halving.IsSuccessiveHalving = true;
+        searches.Add(halving);
+    }
+
+    for (var poolSize: { 8 * RANDOM_FEATURE_COUNT, 16 * RANDOM_FEATURE_COUNT })
+    {
+        var pooled = FeatureSearchOptions();
+        pooled.PoolSize = poolSize;
+        searches.Add(pooled);
+    }
+
+    const float minTPR = 0.99f;
+    var results = List<FeatureSearchResult>();
+
+    for (var& search: searches)
+        results.Add(BenchmarkFeatureSearch(samples, labels, valSamples, valLabels, cascade.TreeDepth, treeCount, minTPR, search));
+
+    Console::WriteLine();
+    Console::Write(FeatureSearchReport(results, minTPR));
+}
+
 /// @brief Runs the app - parses the arguments and runs a training procedure.
 /// @param args Console args.
 static void RunApp(List<string>& args)
 {
     Thread<>::SubscribeErrorHandler(OutputThreadError);
 
+    if (args.Count() > 0 && args[0] == "bench")
+    {
+        RunBenchmark(args);
+        return;
+    }
+
     if (args.Count() > 1)
         throw Exception((string)"Invalid number of arguments.");
 
@@ -42,10 +127,25 @@ static void RunApp(List<string>& args)
     //data init and loading
     Console::WriteLine((string)"Dataset:");
     var transform = RoiRandomJitterTransform();
-    var baseSet   = LabeledDataset(dbPath, cascade.WidthHeightRatio);
+    var baseSet   = LabeledDataset(dbPath, cascade.WidthHeightRatio, config.ImageCacheMB);
 
     var posSet = PositiveDataset(baseSet, &transform);
+    if (config.PositiveCropSize > 0)
+        posSet.CacheCrops((config.SampleSize == 256) ? 0 : config.PositiveCropSize); //the exact grid reads the original pixels
     var negSet = NegativeDataset(baseSet);
+    if (config.PrefetchDepth > 0)
+        negSet.StartPrefetch(config.PrefetchThreads, config.PrefetchDepth);
+
+    var search = FeatureSearchOptions();
+    search.FeatureCount = config.FeatureCount;
+    search.IsSuccessiveHalving = config.SuccessiveHalving;
+    search.PoolSize = config.FeaturePool;
+
+    //negatives of the last stage carried over to the next one - only exact samples are re-scored as the detector would score them
+    var negPool = NegativePool();
+    var useNegativePool = config.NegativePool && config.SampleSize == 256;
+    if (config.NegativePool && !useNegativePool)
+        Console::Warning((string)"The negative pool is disabled - it requires the exact sample size (256).");
 
     //training
     for (var i = cascade.StageCount(); i < config.MinTPRs.Count(); i++)
@@ -54,7 +154,8 @@ static void RunApp(List<string>& args)
         Console::Warning((string)"------- Stage: "  + (i + 1) + " -------");
 
         var minTPR = config.MinTPRs[i];
-        var isStageAppended = TryAppendStage(cascade, posSet, negSet, minTPR, 0.5f, config.MaxFPR, config.MaxTreeCount);
+        var isStageAppended = TryAppendStage(cascade, posSet, negSet, minTPR, 0.5f, config.MaxFPR, config.MaxTreeCount, config.SoftCascade, config.SampleSize, search, config.DenseMining,
+                                             useNegativePool ? &negPool : null);
         if (isStageAppended == false)
             break;
 
@@ -72,6 +173,8 @@ int main(int argCount, char* argValues[])
     Console::ForegroundColor = ConsoleColor::Yellow;
     Console::WriteLine((string)"Argument: [database path] = 'database/'");
     Console::WriteLine((string)"\tExample: 'Train database/'");
+    Console::WriteLine((string)"Feature search benchmark (no training): 'Train bench <database path> [tree count]'");
+    Console::WriteLine((string)"\tExample: 'Train bench database/ 8'");
     Console::WriteLine();
 
     Console::ForegroundColor = ConsoleColor::Default;
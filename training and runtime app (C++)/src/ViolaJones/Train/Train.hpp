@@ -1,22 +1,35 @@
+#pragma once
+
 #include "../Shared/Config.hpp"
 #include "../Shared/Cascade.hpp"
 #include "../Test/Test.hpp"
 #include "Dataset/Dataset.hpp"
 #include "Dataset/SamplePositives.hpp"
+#include "Dataset/NegativePool.hpp"
+#include "FeatureResponses.hpp"
 #include "Util.hpp"
+#include <bit>
 
 namespace ViolaJones
 {
-    using SplitErrorArgs = Tuple<List<Node>&, List<cv::Mat>&, List<float>&, List<float>&, Array<float>&>;
+    /// @brief Gets the random generator used in node training. It is seeded only once, so nodes prepared within the same second get different candidates.
+    ///        Not thread safe - nodes are prepared sequentially.
+    /// @return Random generator.
+    static Random& TrainRandom()
+    {
+        static var rand = Random();
+        return rand;
+    }
 
     /// @brief Creates a collection of random features used in node training.
+    /// @param count Number of features.
     /// @return A list of random features.
-    static List<Node> CreateRandomFeatures()
+    static List<Node> CreateRandomFeatures(int count = RANDOM_FEATURE_COUNT)
     {
         var features = List<Node>();
-        var rand = Random();
+        var& rand = TrainRandom();
 
-        for (var i = 0; i < RANDOM_FEATURE_COUNT; i++)
+        for (var i = 0; i < count; i++)
         {
             var f = Node();
             f.RowA = rand.Next(-127, +127);
@@ -31,170 +44,600 @@ namespace ViolaJones
         return features;
     }
 
-    /// @brief Calculates sum square of errors.
-    /// @param labels Target labels.
-    /// @param weights Sample weights.
-    /// @return Sum square of errors.
-    static float SSE(List<float>& labels, List<float>& weights)
+    /// @brief Sufficient statistics of weighted samples for the sum square of errors: sum of w, w*y and w*y^2.
+    struct SplitStats
     {
-        var weightedAvg = WeightedAverage(labels, weights);
-        var SSE = 0.0;
+        double W = 0;
+        double WY = 0;
+        double WYY = 0;
 
-        for (var i = 0; i < labels.Count(); i++)
+        /// @brief Calculates sum square of errors around the weighted average m = sum(w*y) / (sum(w) + 1e-5).
+        /// @return Sum(w * (y - m)^2) = sum(w*y^2) - 2 * m * sum(w*y) + m^2 * sum(w).
+        double SSE()
+        {
+            var mean = WY / (W + 1e-5);
+            return WYY - 2 * mean * WY + mean * mean * W;
+        }
+
+        SplitStats operator -(const SplitStats& other)
+        {
+            return SplitStats { .W = W - other.W, .WY = WY - other.WY, .WYY = WYY - other.WYY };
+        }
+    };
+
+    /// @brief Per-sample terms of split statistics (w, w*y, w*y^2) for all node samples and their totals.
+    struct SplitTerms
+    {
+        List<float> W;
+        List<float> WY;
+        List<float> WYY;
+        SplitStats Total;
+    };
+
+    /// @brief Calculates per-sample terms of split statistics and node-level totals.
+    /// @param sampleIndices Sample indices.
+    /// @param start Index of the first node sample index.
+    /// @param count Number of node samples.
+    /// @param labels Patch labels (all samples).
+    /// @param weights Sample weights (all samples).
+    /// @param isUnitWeight True to use a unit weight for each sample instead of its weight (weighted subsets, see DrawWeightedSubset).
+    /// @return Split terms (in the order of the node sample indices).
+    static SplitTerms CalculateSplitTerms(List<int>& sampleIndices, int start, int count, List<float>& labels, List<float>& weights, bool isUnitWeight = false)
+    {
+        var terms = SplitTerms();
+
+        for (var i = start; i < start + count; i++)
         {
-            var delta = labels[i] - weightedAvg;
-            SSE += (delta * delta * weights[i]);
+            var sampleIdx = sampleIndices[i];
+            var w = isUnitWeight ? 1.0f : weights[sampleIdx], wy = w * labels[sampleIdx], wyy = wy * labels[sampleIdx];
+            terms.W.Add(w);
+            terms.WY.Add(wy);
+            terms.WYY.Add(wyy);
+
+            terms.Total.W += w;
+            terms.Total.WY += wy;
+            terms.Total.WYY += wyy;
         }
 
-        return SSE;
+        return terms;
     }
 
-    /// @brief Calculates split error for a node. The less the error, the better the node.
-    /// @param node Node to evaluate.
-    /// @param patches Image patches.
-    /// @param labels Patch labels.
-    /// @param sampleWeights Sample weights.
-    /// @return Split error for the node.
-    static float CalculateSplitError(Node& node, List<cv::Mat>& patches, List<float>& labels, List<float>& sampleWeights)
+    /// @brief Calculates split error for a feature in a single pass over the samples whose response bits are set (right side); 
+    ///        the left side statistics are the node totals minus the right side ones. The less the error, the better the feature.
+    /// @param bits Feature responses (a feature row).
+    /// @param wordCount Number of words.
+    /// @param terms Per-sample split terms and node totals.
+    /// @return Split error for the feature.
+    static float CalculateSplitError(const UInt64* bits, int wordCount, SplitTerms& terms)
     {
-        var maskRight = List<bool>();
-       
-        for (var i = 0; i < labels.Count(); i++)
+        var w = terms.W.begin(), wy = terms.WY.begin(), wyy = terms.WYY.begin();
+        var right = SplitStats();
+
+        for (var wordIdx = 0; wordIdx < wordCount; wordIdx++)
         {
-            var isTrue = EvalFeature(node, patches[i]);
-            maskRight.Add(isTrue);
+            var word = bits[wordIdx];
+            var offset = wordIdx * 64;
+
+            while (word != 0)
+            {
+                var i = offset + std::countr_zero(word);
+                right.W += w[i];
+                right.WY += wy[i];
+                right.WYY += wyy[i];
+
+                word &= word - 1;
+            }
         }
 
-        var maskLeft = LogicalNot(maskRight);
+        var left = terms.Total - right;
+        var err = (left.SSE() + right.SSE()) / terms.Total.W;
+        return err;
+    }
 
-        var labelsLeft = labels.Get(maskLeft);
-        var weightsLeft = sampleWeights.Get(maskLeft);
-        var errLeft  = SSE(labelsLeft, weightsLeft);
+    /// @brief Calculates split error for a pool feature restricted to node samples: only the set bits of (responses & node mask) are visited (see CalculateSplitError).
+    /// @param bits Pool feature responses over all samples (a pool row).
+    /// @param mask Node mask - bit i is set if sample i belongs to the node.
+    /// @param wordCount Number of words.
+    /// @param terms Per-sample split terms of all samples (in the sample order).
+    /// @param total Node totals.
+    /// @return Split error for the feature.
+    static float CalculateSplitError(const UInt64* bits, const UInt64* mask, int wordCount, SplitTerms& terms, SplitStats total)
+    {
+        var w = terms.W.begin(), wy = terms.WY.begin(), wyy = terms.WYY.begin();
+        var right = SplitStats();
 
-        var labelsRight = labels.Get(maskRight);
-        var weightsRight = sampleWeights.Get(maskRight);
-        var errRight = SSE(labelsRight, weightsRight);
+        for (var wordIdx = 0; wordIdx < wordCount; wordIdx++)
+        {
+            var word = bits[wordIdx] & mask[wordIdx];
+            var offset = wordIdx * 64;
+
+            while (word != 0)
+            {
+                var i = offset + std::countr_zero(word);
+                right.W += w[i];
+                right.WY += wy[i];
+                right.WYY += wyy[i];
+
+                word &= word - 1;
+            }
+        }
 
-        var err = (errLeft + errRight) / Sum(sampleWeights);
+        var left = total - right;
+        var err = (left.SSE() + right.SSE()) / total.W;
         return err;
     }
 
-    /// @brief Calculates split errors for the provided features in parallel (if enabled).
-    /// @param features Feature (node) collection.
-    /// @param patches Image patches.
-    /// @param labels Patch labels.
-    /// @param weights Sample weights.
-    /// @return A collection of split errors; one for each node.
-    static Array<float> CalculateSplitErrors(List<Node>& features, List<cv::Mat>& patches, List<float>& labels, List<float>& weights)
-    {      
-        var errors = Array<float>(features.Count());
+    /// @brief Partitions node sample indices in place according to the responses of the selected feature (quicksort-style): 
+    ///        samples with false responses (left) are moved to the front, samples with true responses (right) to the back.
+    ///        Each position is visited once, before it is swapped, so the responses stay valid for the positions which are not visited yet.
+    /// @param responses Feature responses (bit i corresponds to sampleIndices[start + i]).
+    /// @param featureIdx Selected feature index.
+    /// @param sampleIndices Sample indices.
+    /// @param start Index of the first node sample index.
+    /// @return Number of left samples.
+    static int PartitionSamples(FeatureResponses& responses, int featureIdx, List<int>& sampleIndices, int start)
+    {
+        var lo = 0, hi = responses.SampleCount - 1;
 
-#ifndef PARALLEL   
-        for (var i = 0; i < features.Count(); i++)
+        while (lo <= hi)
         {
-            var error = CalculateSplitError(features[i], patches, labels, weights);
-            errors[i] = error;
+            if (!responses.Get(featureIdx, lo))
+                lo++;
+            else if (responses.Get(featureIdx, hi))
+                hi--;
+            else
+            {
+                var tmp = sampleIndices[start + lo];
+                sampleIndices[start + lo] = sampleIndices[start + hi];
+                sampleIndices[start + hi] = tmp;
+                lo++; hi--;
+            }
         }
-#else
-        var splitErrorsArgs = SplitErrorArgs(features, patches, labels, weights, errors);
-        Parallel<SplitErrorArgs>::For(0, features.Count(), [](SplitErrorArgs args, long i, bool& shouldCancel) 
+
+        return lo;
+    }
+
+    /// @brief Partitions node sample indices in place according to the pool responses of the selected feature (see PartitionSamples).
+    /// @param pool Feature pool.
+    /// @param poolIdx Selected pool feature index.
+    /// @param sampleIndices Sample indices.
+    /// @param start Index of the first node sample index.
+    /// @param count Number of node samples.
+    /// @return Number of left samples.
+    static int PartitionPoolSamples(FeaturePool& pool, int poolIdx, List<int>& sampleIndices, int start, int count)
+    {
+        var lo = start, hi = start + count - 1;
+
+        while (lo <= hi)
         {
-            var& [features, patches, labels, weights, out] = args;
+            if (!pool.Responses.Get(poolIdx, sampleIndices[lo]))
+                lo++;
+            else if (pool.Responses.Get(poolIdx, sampleIndices[hi]))
+                hi--;
+            else
+            {
+                var tmp = sampleIndices[lo];
+                sampleIndices[lo] = sampleIndices[hi];
+                sampleIndices[hi] = tmp;
+                lo++; hi--;
+            }
+        }
 
-            var error = CalculateSplitError(features[i], patches, labels, weights);
-            out[i] = error;
-        }, 
-        splitErrorsArgs);
-#endif
+        return lo - start;
+    }
 
-        return errors;
+    /// @brief Creates a stage feature pool: draws random features and evaluates them on all samples of the store (see CalculateFeatureResponses).
+    /// @param samples Sample store (stage samples).
+    /// @param poolSize Number of pool features.
+    /// @return Feature pool.
+    static FeaturePool CreateFeaturePool(SampleStore& samples, int poolSize)
+    {
+        var sampleIndices = List<int>();
+        for (var i = 0; i < samples.Count(); i++)
+            sampleIndices.Add(i);
+
+        var pool = FeaturePool();
+        pool.Features = CreateRandomFeatures(poolSize);
+        pool.Responses = CalculateFeatureResponses(pool.Features, samples, sampleIndices, 0, sampleIndices.Count());
+        return pool;
     }
 
-    /// @brief Evaluates selected feature against all samples to split the samples into two collections.
-    /// @param node Node (feature) to evaluate.
-    /// @param patches Image patches.
-    /// @return Left and right indices for samples, weights and labels.
-    static Tuple<List<int>, List<int>> SplitSamples(Node& node, List<cv::Mat>& patches)
+    /// @brief Draws distinct random pool feature indices (partial Fisher-Yates shuffle).
+    /// @param poolSize Number of pool features.
+    /// @param count Number of drawn indices (at most the pool size).
+    /// @return Pool feature indices.
+    static List<int> DrawPoolIndices(int poolSize, int count)
     {
-        List<int> indicesLeft, indicesRight;
+        var indices = List<int>();
+        for (var i = 0; i < poolSize; i++)
+            indices.Add(i);
+
+        count = Math::Min(count, poolSize);
+        var& rand = TrainRandom();
+        var drawn = List<int>();
 
-        for (var i = 0; i < patches.Count(); i++)
+        for (var i = 0; i < count; i++)
         {
-            var isTrue = EvalFeature(node, patches[i]);
-            if (isTrue)
-                indicesRight.Add(i);
-            else
-                indicesLeft.Add(i);
+            var j = Math::Min(rand.Next(i, poolSize), poolSize - 1);
+            var tmp = indices[i]; indices[i] = indices[j]; indices[j] = tmp;
+            drawn.Add(indices[i]);
         }
 
-        return Tuple<List<int>, List<int>>(indicesLeft, indicesRight);
+        return drawn;
     }
 
-    /// @brief Grows a tree using depth first node expansion (recursively). The function ensures that the tree is full.
-    /// @param tree Tree to build.
-    /// @param nodeIndex Current node index.
-    /// @param patches Image patches.
-    /// @param labels Patch labels.
-    /// @param weights Sample weights.
-    /// @param depth Current tree depth.
-    /// @param maxDepth Max tree depth / target depth.
-    static void TrainNode(Tree& tree, int nodeIndex, List<cv::Mat>& patches, List<float>& labels, List<float>& weights, int depth, int maxDepth)
+    /// @brief Draws a weighted random subset of node samples (with replacement, the probability is proportional to the weight) by systematic sampling: 
+    ///        equally spaced points with a single random offset over the cumulative node weights, hence the subset keeps the order of the node samples.
+    ///        With a unit weight per drawn sample, the subset split error estimates the weighted split error.
+    /// @param sampleIndices Sample indices.
+    /// @param start Index of the first node sample index.
+    /// @param count Number of node samples.
+    /// @param weights Sample weights (all samples).
+    /// @param subsetSize Number of drawn samples.
+    /// @return Sample indices of the subset (may contain duplicates).
+    static List<int> DrawWeightedSubset(List<int>& sampleIndices, int start, int count, List<float>& weights, int subsetSize)
     {
-        //if we reached the end of a tree set the average value into its leafs
-        if (depth == maxDepth)
+        var weightSum = 0.0;
+        for (var i = start; i < start + count; i++)
+            weightSum += weights[sampleIndices[i]];
+
+        var subset = List<int>();
+        var step = weightSum / subsetSize;
+        var point = TrainRandom().NextDouble() * step;
+        var cumWeight = 0.0;
+
+        for (var i = start; i < start + count && subset.Count() < subsetSize; i++)
         {
-            var leafIdx = nodeIndex - (Math::Pow(2, maxDepth) - 1);
+            cumWeight += weights[sampleIndices[i]];
 
-            if (labels.Count() == 0)
-                tree.Leafs[leafIdx] = 0;
-            else
-                tree.Leafs[leafIdx] = WeightedAverage(labels, weights);
+            for (; point < cumWeight && subset.Count() < subsetSize; point += step)
+                subset.Add(sampleIndices[i]);
+        }
 
-            return;
+        return subset;
+    }
+
+    /// @brief A node of the tree level being trained: a range of the tree sample indices and the state of its feature search.
+    struct LevelNode
+    {
+        int NodeIndex;
+        /// @brief Index of the first node sample index.
+        int Start;
+        /// @brief Number of node samples.
+        int Count;
+
+        /// @brief Remaining candidate features.
+        List<Node> Features;
+        List<FeatureOffset> Offsets;
+        /// @brief Sample indices the candidates are scored on in the current search round.
+        List<int> RoundIndices;
+        /// @brief True if the current round scores a weighted subset, false if it scores all node samples (the final round).
+        bool IsSubsetRound;
+        /// @brief Subset size of the next round. If not smaller than the node sample count, the next round is the final one.
+        int SubsetSize;
+        /// @brief True when the final round is scored.
+        bool IsSearched;
+
+        /// @brief Feature pool mode: pool indices of the candidates.
+        List<int> PoolIndices;
+        /// @brief Feature pool mode: node mask over all samples (bit i is set if sample i belongs to the node). Only Terms.Total is used.
+        List<UInt64> Mask;
+
+        FeatureResponses Responses;
+        SplitTerms Terms;
+        List<float> Errors;
+    };
+
+    /// @brief Prepares a feature search round of a node: selects the samples the remaining candidates are scored on and calculates their split terms.
+    /// @param node Level node.
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (shared by all nodes of the tree).
+    /// @param labels Patch labels (all samples).
+    /// @param weights Sample weights (all samples).
+    static void PrepareSearchRound(LevelNode& node, SampleStore& samples, List<int>& sampleIndices, List<float>& labels, List<float>& weights)
+    {
+        node.IsSubsetRound = node.SubsetSize < node.Count;
+
+        if (node.IsSubsetRound)
+            node.RoundIndices = DrawWeightedSubset(sampleIndices, node.Start, node.Count, weights, node.SubsetSize);
+        else
+        {
+            //the same order as the node range, so the responses of the final round can be used for the partitioning
+            node.RoundIndices.Clear();
+            for (var i = node.Start; i < node.Start + node.Count; i++)
+                node.RoundIndices.Add(sampleIndices[i]);
         }
 
-        //if we run out of data create default node (does not matter) and keep building the tree 
-        if (labels.Count() <= 1)
+        var roundCount = (int)node.RoundIndices.Count();
+        node.Offsets = samples.GetFeatureOffsets(node.Features);
+        node.Responses = FeatureResponses(node.Features.Count(), roundCount);
+        node.Terms = CalculateSplitTerms(node.RoundIndices, 0, roundCount, labels, weights, node.IsSubsetRound);
+
+        node.Errors.Clear();
+        node.Errors.Add(0.0f, node.Features.Count());
+    }
+
+    /// @brief Keeps only the candidates with the lowest split errors of the current round.
+    /// @param node Level node.
+    /// @param keepCount Number of kept candidates.
+    static void KeepBestFeatures(LevelNode& node, int keepCount)
+    {
+        var order = ArgSort(node.Errors);
+
+        var features = List<Node>();
+        for (var i = 0; i < keepCount; i++)
+            features.Add(node.Features[order[i]]);
+
+        node.Features = features;
+    }
+
+    /// @brief A unit of parallel work within a tree level: a node and an item (a response word or a feature) of the node.
+    struct LevelWorkUnit
+    {
+        int NodeIdx;
+        int Item;
+    };
+
+    using LevelWorkArgs = Tuple<List<LevelNode>&, List<LevelWorkUnit>&, SampleStore&, FeaturePool&, SplitTerms&>;
+
+    /// @brief Evaluates candidate features of all level nodes on their round samples. A work unit is a (node, response word) pair.
+    /// @param args Level nodes, work units, sample store, feature pool and split terms of all samples (pool mode).
+    /// @param unitIdx Work unit index.
+    /// @param shouldCancel Cancellation token (not used).
+    static void EvalLevelResponses(LevelWorkArgs args, long unitIdx, bool& shouldCancel)
+    {
+        var& [nodes, units, samples, pool, sampleTerms] = args;
+        var& unit = units[unitIdx];
+        var& node = nodes[unit.NodeIdx];
+
+        EvalFeatureWord(node.Offsets, samples, node.RoundIndices, 0, node.Responses, unit.Item);
+    }
+
+    /// @brief Calculates split errors of candidate features of all level nodes. A work unit is a (node, feature) pair.
+    /// @param args Level nodes, work units, sample store, feature pool and split terms of all samples (pool mode).
+    /// @param unitIdx Work unit index.
+    /// @param shouldCancel Cancellation token (not used).
+    static void EvalLevelSplitErrors(LevelWorkArgs args, long unitIdx, bool& shouldCancel)
+    {
+        var& [nodes, units, samples, pool, sampleTerms] = args;
+        var& unit = units[unitIdx];
+        var& node = nodes[unit.NodeIdx];
+
+        node.Errors[unit.Item] = CalculateSplitError(node.Responses.Row(unit.Item), node.Responses.WordCount, node.Terms);
+    }
+
+    /// @brief Calculates split errors of pool candidates of all level nodes from the cached pool responses. A work unit is a (node, feature) pair.
+    /// @param args Level nodes, work units, sample store, feature pool and split terms of all samples (pool mode).
+    /// @param unitIdx Work unit index.
+    /// @param shouldCancel Cancellation token (not used).
+    static void EvalLevelPoolSplitErrors(LevelWorkArgs args, long unitIdx, bool& shouldCancel)
+    {
+        var& [nodes, units, samples, pool, sampleTerms] = args;
+        var& unit = units[unitIdx];
+        var& node = nodes[unit.NodeIdx];
+
+        var poolIdx = node.PoolIndices[unit.Item];
+        node.Errors[unit.Item] = CalculateSplitError(pool.Responses.Row(poolIdx), node.Mask.begin(), pool.Responses.WordCount, sampleTerms, node.Terms.Total);
+    }
+
+    /// @brief Runs a level work function over all work units (in parallel if enabled).
+    /// @param work Work function.
+    /// @param args Level nodes, work units, sample store, feature pool and split terms of all samples (pool mode).
+    static void RunLevelWork(void (*work)(LevelWorkArgs, long, bool&), LevelWorkArgs args)
+    {
+        var& [nodes, units, samples, pool, sampleTerms] = args;
+
+#ifndef PARALLEL
+        var shouldCancel = false;
+        for (var i = 0; i < units.Count(); i++)
+            work(args, i, shouldCancel);
+#else
+        Parallel<LevelWorkArgs>::For(0, units.Count(), work, args);
+#endif
+    }
+
+    /// @brief Searches the best features of the level nodes by scoring random candidates on node samples (pixel comparisons).
+    ///        The search runs in rounds (see FeatureSearchOptions): in the exhaustive search there is a single round over all node samples, 
+    ///        in the successive halving the candidates are scored on growing weighted subsets and the best 1 / ReductionFactor of them survive each round.
+    ///        When done, the node responses and errors correspond to the final round (all node samples).
+    /// @param nodes Trained level nodes (with at least 2 samples).
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (shared by all nodes of the tree).
+    /// @param labels Patch labels (all samples).
+    /// @param weights Sample weights (all samples).
+    /// @param search Feature search options.
+    /// @param pool Feature pool (not used).
+    /// @param sampleTerms Split terms of all samples (not used).
+    static void SearchNodeFeatures(List<LevelNode>& nodes, SampleStore& samples, List<int>& sampleIndices, List<float>& labels, List<float>& weights, 
+                                   const FeatureSearchOptions& search, FeaturePool& pool, SplitTerms& sampleTerms)
+    {
+        for (var& node: nodes)
         {
-            tree.Nodes[nodeIndex] = Node();
-            TrainNode(tree, 2 * nodeIndex + 1, patches, labels, weights, depth + 1, maxDepth);
-            TrainNode(tree, 2 * nodeIndex + 2, patches, labels, weights, depth + 1, maxDepth);
-            return;
+            node.Features = CreateRandomFeatures(search.FeatureCount);
+            node.SubsetSize = search.IsSuccessiveHalving ? search.MinSampleCount : node.Count;
         }
 
-        //create feature candidates
-        var features = CreateRandomFeatures();
-        var featureCount = features.Count();
+        //search rounds - the nodes which are still searching are scored together
+        var isSearching = nodes.Count() > 0;
+        while (isSearching)
+        {
+            var responseUnits = List<LevelWorkUnit>();
+            var errorUnits = List<LevelWorkUnit>();
+
+            for (var nodeIdx = 0; nodeIdx < nodes.Count(); nodeIdx++)
+            {
+                var& node = nodes[nodeIdx];
+                if (node.IsSearched)
+                    continue;
+
+                PrepareSearchRound(node, samples, sampleIndices, labels, weights);
+
+                for (var wordIdx = 0; wordIdx < node.Responses.WordCount; wordIdx++)
+                    responseUnits.Add(LevelWorkUnit { .NodeIdx = nodeIdx, .Item = wordIdx });
+
+                for (var featureIdx = 0; featureIdx < node.Features.Count(); featureIdx++)
+                    errorUnits.Add(LevelWorkUnit { .NodeIdx = nodeIdx, .Item = featureIdx });
+            }
+
+            //evaluate candidates on round samples and calculate their split errors
+            RunLevelWork(EvalLevelResponses,   LevelWorkArgs(nodes, responseUnits, samples, pool, sampleTerms));
+            RunLevelWork(EvalLevelSplitErrors, LevelWorkArgs(nodes, errorUnits, samples, pool, sampleTerms));
+
+            isSearching = false;
+            for (var& node: nodes)
+            {
+                if (node.IsSearched)
+                    continue;
+
+                if (node.IsSubsetRound)
+                {
+                    var keepCount = (int)(node.Features.Count() + search.ReductionFactor - 1) / search.ReductionFactor;
+                    KeepBestFeatures(node, keepCount);
+                    node.SubsetSize *= search.ReductionFactor;
+                    isSearching = true;
+                }
+                else
+                    node.IsSearched = true;
+            }
+        }
+    }
 
-        //calculate error for all features
-        var errors = CalculateSplitErrors(features, patches, labels, weights);
+    /// @brief Searches the best features of the level nodes among candidates picked from the stage feature pool.
+    ///        Responses are taken from the pool, so a node only accumulates split statistics over (pool responses & node mask).
+    /// @param nodes Trained level nodes (with at least 2 samples).
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (shared by all nodes of the tree).
+    /// @param search Feature search options (the number of candidates per node).
+    /// @param pool Feature pool.
+    /// @param sampleTerms Split terms of all samples (in the sample order).
+    static void SearchPoolFeatures(List<LevelNode>& nodes, SampleStore& samples, List<int>& sampleIndices, 
+                                   const FeatureSearchOptions& search, FeaturePool& pool, SplitTerms& sampleTerms)
+    {
+        var errorUnits = List<LevelWorkUnit>();
+
+        for (var nodeIdx = 0; nodeIdx < nodes.Count(); nodeIdx++)
+        {
+            var& node = nodes[nodeIdx];
+            node.PoolIndices = DrawPoolIndices(pool.Features.Count(), search.FeatureCount);
 
-        //select the best feature (that has the min split error)
-        var bestFeatureIdx = Argmin(errors);
-        var bestFeature = features[bestFeatureIdx];
-        tree.Nodes[nodeIndex] = bestFeature;
+            node.Features.Clear();
+            for (var poolIdx: node.PoolIndices)
+                node.Features.Add(pool.Features[poolIdx]);
 
-        //split samples according to the selected feature and build next nodes recursively
-        var [indicesLeft, indicesRight] = SplitSamples(bestFeature, patches);
+            //node mask and totals
+            node.Mask.Add(0, pool.Responses.WordCount);
+            node.Terms = SplitTerms();
 
-        var leftPatches = patches.GetAt(indicesLeft); 
-        var leftLabels = labels.GetAt(indicesLeft);
-        var leftWeights = weights.GetAt(indicesLeft);
-        TrainNode(tree, 2 * nodeIndex + 1, leftPatches,  leftLabels, leftWeights,  depth + 1, maxDepth);
+            for (var i = node.Start; i < node.Start + node.Count; i++)
+            {
+                var sampleIdx = sampleIndices[i];
+                node.Mask[sampleIdx / 64] |= (UInt64)1 << (sampleIdx % 64);
 
-        var rightPatches = patches.GetAt(indicesRight); 
-        var rightLabels = labels.GetAt(indicesRight);
-        var rightWeights = weights.GetAt(indicesRight);
-        TrainNode(tree, 2 * nodeIndex + 2, rightPatches, rightLabels, rightWeights, depth + 1, maxDepth);
+                node.Terms.Total.W += sampleTerms.W[sampleIdx];
+                node.Terms.Total.WY += sampleTerms.WY[sampleIdx];
+                node.Terms.Total.WYY += sampleTerms.WYY[sampleIdx];
+            }
+
+            node.Errors.Add(0.0f, node.Features.Count());
+
+            for (var featureIdx = 0; featureIdx < node.Features.Count(); featureIdx++)
+                errorUnits.Add(LevelWorkUnit { .NodeIdx = nodeIdx, .Item = featureIdx });
+        }
+
+        RunLevelWork(EvalLevelPoolSplitErrors, LevelWorkArgs(nodes, errorUnits, samples, pool, sampleTerms));
+    }
+
+    /// @brief Trains all nodes of a tree level together: split errors (and candidate responses) of all nodes are computed by the same parallel loops,
+    ///        so small nodes deep in the tree do not leave threads idle. Node samples are partitioned in place for the next level.
+    /// @param tree Tree to build.
+    /// @param levelNodes Nodes of the level (samples ranges).
+    /// @param samples Sample store.
+    /// @param sampleIndices Sample indices (shared by all nodes of the tree).
+    /// @param labels Patch labels (all samples).
+    /// @param weights Sample weights (all samples).
+    /// @param search Feature search options.
+    /// @param pool Stage feature pool. If empty, node candidates are drawn and evaluated per node (see SearchNodeFeatures).
+    /// @param sampleTerms Split terms of all samples (in the sample order) - used only with the feature pool.
+    /// @return Nodes of the next level.
+    static List<LevelNode> TrainLevel(Tree& tree, List<LevelNode>& levelNodes, SampleStore& samples, List<int>& sampleIndices, List<float>& labels, List<float>& weights, 
+                                      const FeatureSearchOptions& search, FeaturePool& pool, SplitTerms& sampleTerms)
+    {
+        //nodes with less than 2 samples get a default node which does not matter
+        var nodes = List<LevelNode>();
+        for (var& levelNode: levelNodes)
+        {
+            if (levelNode.Count > 1)
+                nodes.Add(levelNode);
+        }
+
+        var isPool = pool.Features.Count() > 0;
+        if (isPool)
+            SearchPoolFeatures(nodes, samples, sampleIndices, search, pool, sampleTerms);
+        else
+            SearchNodeFeatures(nodes, samples, sampleIndices, labels, weights, search, pool, sampleTerms);
+
+        //select the best feature (that has the min split error) and partition node samples for the next level
+        var nextNodes = List<LevelNode>();
+        var trainedIdx = 0;
+
+        for (var& levelNode: levelNodes)
+        {
+            var leftCount = levelNode.Count, rightCount = levelNode.Count; //both children keep all samples if the node is not trained
+
+            if (levelNode.Count > 1)
+            {
+                var& node = nodes[trainedIdx++];
+                var bestFeatureIdx = Argmin(node.Errors);
+                tree.Nodes[node.NodeIndex] = node.Features[bestFeatureIdx];
+
+                leftCount = isPool ? PartitionPoolSamples(pool, node.PoolIndices[bestFeatureIdx], sampleIndices, node.Start, node.Count) :
+                                     PartitionSamples(node.Responses, bestFeatureIdx, sampleIndices, node.Start);
+                rightCount = node.Count - leftCount;
+            }
+            else
+                tree.Nodes[levelNode.NodeIndex] = Node();
+
+            var rightStart = (levelNode.Count > 1) ? levelNode.Start + leftCount : levelNode.Start;
+            nextNodes.Add(LevelNode { .NodeIndex = 2 * levelNode.NodeIndex + 1, .Start = levelNode.Start, .Count = leftCount });
+            nextNodes.Add(LevelNode { .NodeIndex = 2 * levelNode.NodeIndex + 2, .Start = rightStart,      .Count = rightCount });
+        }
+
+        return nextNodes;
+    }
+
+    /// @brief Sets leaf values: the weighted average of the leaf sample labels (see WeightedAverage).
+    /// @param tree Tree to build.
+    /// @param leafNodes Nodes of the last level.
+    /// @param sampleIndices Sample indices (shared by all nodes of the tree).
+    /// @param labels Patch labels (all samples).
+    /// @param weights Sample weights (all samples).
+    static void SetLeafs(Tree& tree, List<LevelNode>& leafNodes, List<int>& sampleIndices, List<float>& labels, List<float>& weights)
+    {
+        for (var& node: leafNodes)
+        {
+            var leafIdx = node.NodeIndex - (int)tree.Nodes.Count();
+            var s = 0.0f, weightsSum = 0.0f;
+
+            for (var i = node.Start; i < node.Start + node.Count; i++)
+            {
+                s += labels[sampleIndices[i]] * weights[sampleIndices[i]];
+                weightsSum += weights[sampleIndices[i]];
+            }
+
+            tree.Leafs[leafIdx] = (node.Count == 0) ? 0 : s / (weightsSum + 1e-5);
+        }
     }
 
     /// @brief Trains a tree. The trained tree is full meaning that all the leafs reside on the same level (max depth).
-    /// @param patches Image patches.
+    ///        The tree is grown breadth first - level by level (see TrainLevel).
+    /// @param samples Sample store.
     /// @param labels Patch labels.
     /// @param weights Sample weights.
     /// @param maxDepth Max tree depth / target depth.
+    /// @param search Node feature search options.
+    /// @param pool Stage feature pool (see CreateFeaturePool). If empty, node candidates are drawn and evaluated per node.
     /// @return Trained tree.
-    static Tree TrainTree(List<cv::Mat>& patches, List<float>& labels, List<float>& weights, int maxDepth)
+    static Tree TrainTree(SampleStore& samples, List<float>& labels, List<float>& weights, int maxDepth, const FeatureSearchOptions& search, FeaturePool& pool)
     {
         var tree = Tree();
         tree.Threshold = -1000.0f;
@@ -205,10 +648,36 @@ namespace ViolaJones
         for (var i = 0; i < Math::Pow(2, maxDepth); i++)
             tree.Leafs.Add(0.0f);
 
-        TrainNode(tree, 0, patches, labels, weights, 0, maxDepth);
+        var sampleIndices = List<int>();
+        for (var i = 0; i < samples.Count(); i++)
+            sampleIndices.Add(i);
+
+        //split terms of all samples are computed once per tree when the pool is used
+        var sampleTerms = (pool.Features.Count() > 0) ? CalculateSplitTerms(sampleIndices, 0, sampleIndices.Count(), labels, weights) : SplitTerms();
+
+        var levelNodes = List<LevelNode>();
+        levelNodes.Add(LevelNode { .NodeIndex = 0, .Start = 0, .Count = (int)sampleIndices.Count() });
+
+        for (var depth = 0; depth < maxDepth; depth++)
+            levelNodes = TrainLevel(tree, levelNodes, samples, sampleIndices, labels, weights, search, pool, sampleTerms);
+
+        SetLeafs(tree, levelNodes, sampleIndices, labels, weights);
         return tree;
     }
 
+    /// @brief Trains a tree without a feature pool (see above).
+    /// @param samples Sample store.
+    /// @param labels Patch labels.
+    /// @param weights Sample weights.
+    /// @param maxDepth Max tree depth / target depth.
+    /// @param search Node feature search options.
+    /// @return Trained tree.
+    static Tree TrainTree(SampleStore& samples, List<float>& labels, List<float>& weights, int maxDepth, const FeatureSearchOptions& search = FeatureSearchOptions())
+    {
+        var pool = FeaturePool();
+        return TrainTree(samples, labels, weights, maxDepth, search, pool);
+    }
+
     /// @brief Calculates weights for the provided labels given classifier confidences using GentleBoost algorithm.
     /// @param labels Target labels.
     /// @param confidences Classifier outputs.
@@ -243,20 +712,81 @@ namespace ViolaJones
         return weights;
     }
  
+    /// @brief Sets a rejection threshold for each (but the last) tree of the last stage (soft cascade).
+    ///        A tree threshold is the lowest output (after the tree) of the positives which pass the stage threshold, 
+    ///        so none of them is rejected earlier and the stage TPR is preserved. Negatives are rejected as soon as possible.
+    /// @param cascade Cascade whose last stage is calibrated.
+    /// @param labels Target patch labels (+1, -1).
+    /// @param outputs Classifier outputs after the whole stage.
+    /// @param treeOutputs Classifier outputs after each tree of the stage.
+    /// @param stageThreshold Stage threshold.
+    static void CalibrateSoftThresholds(Cascade& cascade, List<float>& labels, List<float>& outputs, 
+                                        List<List<float>>& treeOutputs, float stageThreshold)
+    {
+        //positives which pass the stage
+        var passMask = List<bool>();
+        for (var i = 0; i < labels.Count(); i++)
+            passMask.Add(labels[i] > 0 && outputs[i] >= stageThreshold);
+
+        var passLabels = labels.Get(passMask);
+        if (passLabels.Count() == 0)
+            return;
+
+        var firstTreeIdx = cascade.Trees.Count() - treeOutputs.Count();
+        var negCount = 0l, negEvalCount = 0l; //number of negatives and their tree evaluations in the stage
+
+        for (var i = 0; i < treeOutputs.Count() - 1; i++)
+        {
+            var passOutputs = treeOutputs[i].Get(passMask);
+
+            var _ = 0.0f, treeThreshold = 0.0f;
+            Tie<float, float, float>(_, _, treeThreshold) = SearchROC(passLabels, passOutputs, 1.0f);
+
+            cascade.Trees[firstTreeIdx + i].Threshold = treeThreshold;
+        }
+
+        for (var sampleIdx = 0; sampleIdx < labels.Count(); sampleIdx++)
+        {
+            if (labels[sampleIdx] > 0)
+                continue;
+
+            var treeIdx = 0;
+            while (treeIdx < treeOutputs.Count() - 1 && treeOutputs[treeIdx][sampleIdx] >= cascade.Trees[firstTreeIdx + treeIdx].Threshold)
+                treeIdx++;
+
+            negCount++;
+            negEvalCount += treeIdx + 1;
+        }
+
+        Console::WriteLine((string)"Soft cascade - trees per negative: " + String((double)negEvalCount / Math::Max(1l, negCount), 2) + 
+                           " (stage trees: " + (int)treeOutputs.Count() + ")");
+    }
+
     /// @brief Appends a stage to a cascade.
     /// @param cascade A cascade to add a single stage to.
-    /// @param patches Image patches.
+    /// @param samples Sample store (resampled image patches).
     /// @param labels Target patch labels (+1, -1).
     /// @param outputs Classifier outputs - also modified when additional trees are added.
     /// @param minTPR Minimum TPR to retain.
     /// @param maxFPR Max FPR to tolerate for a stage.
     /// @param maxTreeCount Max tree count per stage.
-    static void AppendStage(Cascade& cascade, List<cv::Mat>& patches, 
+    /// @param softCascade True to calibrate a rejection threshold for each tree of the stage (see CalibrateSoftThresholds).
+    /// @param search Node feature search options.
+    static void AppendStage(Cascade& cascade, SampleStore& samples, 
                             List<float>& labels, List<float>& outputs, 
-                            float minTPR, float maxFPR, int maxTreeCount)
+                            float minTPR, float maxFPR, int maxTreeCount, bool softCascade, const FeatureSearchOptions& search)
     {
         var treeIdx = 0; var FPR = 1.0f;
         var threshold = -1000.0f;
+        var treeOutputs = List<List<float>>(); //classifier outputs after each tree of the stage
+
+        //optional stage feature pool - evaluated once on the stage samples, shared by all nodes of all stage trees
+        var pool = FeaturePool();
+        if (search.PoolSize > 0)
+        {
+            pool = CreateFeaturePool(samples, search.PoolSize);
+            Console::WriteLine((string)"Feature pool: " + search.PoolSize + " features, " + String(pool.Responses.Bits.Count() * sizeof(UInt64) / (1024.0 * 1024.0), 1) + " MB");
+        }
 
         Console::WriteLine((string)"Training:");
         while (treeIdx < maxTreeCount && FPR > maxFPR)
@@ -266,13 +796,15 @@ namespace ViolaJones
 
             //train a single tree
             Console::Write((string)"\tTree (" + String(treeIdx + 1).PadLeft(2, '0') + "/" + maxTreeCount + "): ");
-            var tree = TrainTree(patches, labels, weights, cascade.TreeDepth);
+            var tree = TrainTree(samples, labels, weights, cascade.TreeDepth, search, pool);
 
             //update overall classifier confidence for each sample
-            for (var i = 0; i < patches.Count(); i++)
-                outputs[i] += EvalTree(tree, patches[i]);
+            var treeConfs = EvalTreeBatch(samples, tree);
+            for (var i = 0; i < samples.Count(); i++)
+                outputs[i] += treeConfs[i];
 
             cascade.Trees.Add(tree);
+            if (softCascade) treeOutputs.Add(outputs);
 
             //search ROC for cascade threshold to retain min TPR
             var _ = 0.0f;
@@ -284,6 +816,30 @@ namespace ViolaJones
 
         //only the last tree in a stage has a threshold set to a non default value
         cascade.Trees[cascade.Trees.Count() - 1].Threshold = threshold;
+        cascade.StageEnds.Add(cascade.Trees.Count() - 1);
+
+        if (softCascade)
+            CalibrateSoftThresholds(cascade, labels, outputs, treeOutputs, threshold);
+
+        cascade.UpdateRejectBounds();
+    }
+
+    /// @brief Formats image cache statistics of a stage.
+    /// @param stats Image cache statistics.
+    /// @return Hit rate, number of decoded images and the decode time.
+    static string ImageCacheReport(ImageCacheStats stats)
+    {
+        return (string)"hit rate: " + String(stats.HitRate(), 3) + ", decoded images: " + stats.MissCount + 
+               ", decode time: " + String(stats.DecodeMs / 1000, 1) + " s (" + String(stats.DecodeMs / Math::Max(1l, stats.MissCount), 2) + " ms/image)";
+    }
+
+    /// @brief Formats image prefetch statistics of a stage.
+    /// @param stats Prefetch statistics.
+    /// @return Number of prefetched images, the load time and the time the sampling waited for images (stall) or I/O threads waited for a free queue slot (idle).
+    static string PrefetchReport(PrefetchStats stats)
+    {
+        return (string)"images: " + stats.ImageCount + ", load time: " + String(stats.LoadMs / 1000, 1) + " s, stall: " + String(stats.StallMs / 1000, 2) + 
+               " s, I/O idle: " + String(stats.IdleMs / 1000, 1) + " s";
     }
 
     /// @brief Appends a stage onto an existing cascade if target FPR is not achieved.
@@ -294,43 +850,100 @@ namespace ViolaJones
     /// @param maxFPR Max FPR to tolerate for a stage.
     /// @param targetFPR Target FPR to achieve.
     /// @param maxTreeCount Max tree count per stage.
+    /// @param softCascade True to calibrate a rejection threshold for each tree of the stage.
+    /// @param sampleSize Height of the canonical grid training samples are resampled to (the width is given by the cascade width / height ratio).
+    /// @param search Node feature search options.
+    /// @param denseMining True to mine negatives by scanning whole negative images (see SampleFalsePositivesDense), false to classify random negative patches.
+    /// @param negativePool Negatives of the previous stage (see NegativePool). If set, the ones the cascade still accepts are reused, only the shortfall is mined and the pool is replaced by the negatives of the added stage.
+    ///                    At least NEGATIVE_POOL_MIN_MINED_RATIO of the negatives is mined. Requires the exact sample size (256).
     /// @return True if the stage is added, false otherwise.
     bool TryAppendStage(Cascade& cascade, 
-                        LabeledDataset& positives, LabeledDataset& negatives, 
-                        float minTPR, float maxFPR = 0.5f, float targetFPR = 1e-3, int maxTreeCount = 64)
+                        LabeledDataset& positives, NegativeDataset& negatives, 
+                        float minTPR, float maxFPR = 0.5f, float targetFPR = 1e-3, int maxTreeCount = 64, bool softCascade = false, int sampleSize = 64,
+                        const FeatureSearchOptions& search = FeatureSearchOptions(), bool denseMining = false, NegativePool* negativePool = null)
     {
+        //positives and negatives are resampled into a single store: positives first, then negatives (pooled, then mined)
+        var sampleCols = SampleStore::GridCols(sampleSize, cascade.WidthHeightRatio);
+        var samples = SampleStore(sampleSize, sampleCols, 2 * positives.Count());
+
+        if (negativePool != null && samples.IsExact() == false)
+            throw ArgumentException((string)"The negative pool requires the exact sample size (256).");
+
         //sample positives and negatives
+        positives.ResetCacheStats();
+        negatives.ResetCacheStats();
+        negatives.ResetPrefetcherStats();
+
         Console::WriteLine((string)"Positives:");
-        var [tpSamples, tpConfs, tprHitRatio] = SamplePositives(cascade, positives, positives.Count());
+        var [tpConfs, tprHitRatio] = SamplePositives(cascade, positives, samples, positives.Count());
    
-        var nFPsTpPick = 2 * positives.Count() - tpSamples.Count();
+        var nFPsTpPick = 2 * positives.Count() - tpConfs.Count();
         Console::WriteLine((string)"Negatives:");
-        var [fpSamples, fpConfs, fprHitRatio] = SamplePositives(cascade, negatives, nFPsTpPick, targetFPR);
+        var miningStart = Stopwatch::TotalNanoseconds();
+
+        //reuse the pooled negatives the cascade still accepts (only the trees added since they were mined are evaluated)
+        //a part of the negatives is always left for the mining, which measures the FPR of the current cascade
+        var poolConfs = List<float>();
+        var poolCount = 0;
+        var poolSurvivorRatio = 0.0f;
+        if (negativePool != null && negativePool->Count() > 0)
+        {
+            poolCount = negativePool->Count();
+            var poolPickCount = nFPsTpPick - (int)Math::Ceil(nFPsTpPick * NEGATIVE_POOL_MIN_MINED_RATIO);
+            Tie<List<float>, float>(poolConfs, poolSurvivorRatio) = negativePool->TakeSurvivors(cascade, samples, poolPickCount);
+            Console::WriteLine((string)"\tPool survivors: " + (int)poolConfs.Count() + " / " + poolCount + " (survival rate: " + String(poolSurvivorRatio, 3) + ")");
+        }
+
+        //mine the shortfall - the FPR is the hit rate of the mining (the survival rate is biased, the pooled negatives were the training set of the added stage)
+        //and it is checked after as many trials as the full negative count needs
+        var nFPsToMine = nFPsTpPick - (int)poolConfs.Count();
+        var fpConfs = List<float>();
+        var fprHitRatio = 1.0f;
+        if (nFPsToMine > 0)
+        {
+            Tie<List<float>, float>(fpConfs, fprHitRatio) = denseMining ? SampleFalsePositivesDense(cascade, negatives, samples, nFPsToMine, targetFPR, nFPsTpPick) :
+                                                                          SamplePositives(cascade, negatives, samples, nFPsToMine, targetFPR, nFPsTpPick);
+        }
+
+        var miningMs = (double)(Stopwatch::TotalNanoseconds() - miningStart) / 1e6;
         
         Console::ForegroundColor = ConsoleColor::Green;
         Console::WriteLine((string)"\nStats:");
-        Console::WriteLine((string)"\tTPR: " + String(tprHitRatio, 3) + ". FPR: " + String(fprHitRatio, 3) + "\n");
+        Console::WriteLine((string)"\tTPR: " + String(tprHitRatio, 3) + ". FPR: " + String(fprHitRatio, 3));
+        Console::WriteLine((string)"\tNegatives - pooled: " + (int)poolConfs.Count() + ", mined: " + (int)fpConfs.Count() + ", time: " + String(miningMs / 1000, 1) + " s");
+        Console::WriteLine((string)"\tImage cache - positives: " + ImageCacheReport(positives.CacheStats()));
+        if (negatives.IsPrefetching()) //prefetched images bypass the image cache
+            Console::WriteLine((string)"\tPrefetch - negatives: " + PrefetchReport(negatives.PrefetcherStats()));
+        else
+            Console::WriteLine((string)"\tImage cache - negatives: " + ImageCacheReport(negatives.CacheStats()));
+        Console::WriteLine();
         Console::ForegroundColor = ConsoleColor::Default;
 
         //if we reached the target FPR, we are done
         if (fprHitRatio <= targetFPR)
             return false;
 
-        //concatenate positive and negative data (samples + labels)
-        var labels = List<float>();
-        labels.Add(+1.0f, tpSamples.Count());
-        labels.Add(-1.0f, fpSamples.Count());
+        //concatenate positive and negative data (labels + confidences)
+        var negConfs = List<float>();
+        negConfs.AddRange(poolConfs);
+        negConfs.AddRange(fpConfs);
 
-        var samples = List<cv::Mat>();
-        samples.AddRange(tpSamples);
-        samples.AddRange(fpSamples);
+        var labels = List<float>();
+        labels.Add(+1.0f, tpConfs.Count());
+        labels.Add(-1.0f, negConfs.Count());
 
         var confs = List<float>();
         confs.AddRange(tpConfs);
-        confs.AddRange(fpConfs);
+        confs.AddRange(negConfs);
 
         //add single stage
-        AppendStage(cascade, samples, labels, confs, minTPR, maxFPR, maxTreeCount);
+        var stageTreeCount = (int)cascade.Trees.Count();
+        AppendStage(cascade, samples, labels, confs, minTPR, maxFPR, maxTreeCount, softCascade, search);
+
+        //keep the stage negatives (with their confidences before the stage trees) for the next stage
+        if (negativePool != null)
+            negativePool->Set(samples, tpConfs.Count(), negConfs, stageTreeCount);
+
         return true;
     }
 
@@ -111,23 +111,94 @@ namespace ViolaJones
         return Tuple<float, float>(TPR, FPR);
     }
 
-    /// @brief Searches a threshold on a ROC curve where minimum TPR is achieved.
+    /// @brief Maps a float to an unsigned integer key with the same ordering.
+    /// @param value Float value (not NaN).
+    /// @return Sort key.
+    static UInt32 FloatSortKey(float value)
+    {
+        UInt32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    /// @brief Sorts value indices by values in ascending order. Stable LSD radix sort (4 passes of 8 bits) - O(N) regardless of ties.
+    /// @param values Values.
+    /// @return Indices of values in ascending order of values.
+    static List<int> ArgSort(List<float>& values)
+    {
+        var n = (int)values.Count();
+        var keys = List<UInt32>(), keysTmp = List<UInt32>();
+        var indices = List<int>(), indicesTmp = List<int>();
+
+        for (var i = 0; i < n; i++)
+        {
+            keys.Add(FloatSortKey(values[i]));
+            indices.Add(i);
+        }
+        keysTmp.Add(0, n);
+        indicesTmp.Add(0, n);
+
+        var src = &keys, dst = &keysTmp;
+        var srcIndices = &indices, dstIndices = &indicesTmp;
+
+        for (var shift = 0; shift < 32; shift += 8)
+        {
+            int offsets[257] = {};
+            for (var i = 0; i < n; i++)
+                offsets[(((*src)[i] >> shift) & 0xFF) + 1]++;
+
+            for (var b = 0; b < 256; b++)
+                offsets[b + 1] += offsets[b];
+
+            for (var i = 0; i < n; i++)
+            {
+                var pos = offsets[((*src)[i] >> shift) & 0xFF]++;
+                (*dst)[pos] = (*src)[i];
+                (*dstIndices)[pos] = (*srcIndices)[i];
+            }
+
+            //even number of passes - the result ends in the original lists
+            var tmp = src; src = dst; dst = tmp;
+            var tmpIndices = srcIndices; srcIndices = dstIndices; dstIndices = tmpIndices;
+        }
+
+        return indices;
+    }
+
+    /// @brief Searches the highest threshold on a ROC curve where minimum TPR is achieved (outputs >= threshold are positive).
+    ///        Outputs are sorted once and cumulative TP / FP counts are swept from the highest output, hence the threshold is exactly one of the outputs.
     /// @param labels Target values.
     /// @param outputs Classifier outputs.
     /// @param minTPR Minimum TPR to target.
     /// @return TPR, FPR and threshold.
     Tuple<float, float, float> SearchROC(List<float>& labels, List<float>& outputs, float minTPR)
     {
-        var TPR = 0.0f, FPR = -1.0f;
+        var nPos = 0l, nNeg = 0l;
+        for (var i = 0; i < labels.Count(); i++)
+        {
+            if (labels[i] > 0) nPos++;
+            else               nNeg++;
+        }
 
-        var threshold = 0.0f;
-        for (var i = 0; i < outputs.Count(); i++)
-            threshold = Math::Max(threshold, outputs[i]);
+        var order = ArgSort(outputs);
+        var TP = 0l, FP = 0l;
+        var TPR = 0.0f, FPR = 0.0f, threshold = 0.0f;
 
-        while (TPR < minTPR)
+        //lower the threshold from the highest output; all samples with an equal output are accepted together
+        var i = (long)order.Count() - 1;
+        while (i >= 0)
         {
-            Tie<float, float>(TPR, FPR) = CalculateRocPoint(labels, outputs, threshold);
-            threshold -= 0.001;
+            threshold = outputs[order[i]];
+            for (; i >= 0 && outputs[order[i]] == threshold; i--)
+            {
+                if (labels[order[i]] > 0) TP++;
+                else                      FP++;
+            }
+
+            TPR = (nPos > 0) ? (float)TP / nPos : 1.0f;
+            FPR = (nNeg > 0) ? (float)FP / nNeg : 0.0f;
+            if (TPR >= minTPR)
+                break;
         }
 
         return Tuple<float, float, float>(TPR, FPR, threshold);